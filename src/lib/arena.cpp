@@ -0,0 +1,64 @@
+#include "arena.h"
+#include "state.h"
+
+void BufferArena::Slice::bind(Buffer::BufferType type, u32 bindingPoint) const {
+	StateCache::get().bindBufferRange(GLenum(type), bindingPoint, buffer, offset, size);
+}
+
+BufferArena& BufferArena::create(u32 frameSize, u32 framesInFlight) {
+	GLint uboAlign = 1, ssboAlign = 1;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlign);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssboAlign);
+	m_uniformAlignment = u32(uboAlign);
+	m_storageAlignment = u32(ssboAlign);
+
+	m_buffer.create(Buffer::ArrayBuffer, frameSize, framesInFlight);
+	m_region = m_buffer.begin();
+	m_head = 0;
+
+	return *this;
+}
+
+void BufferArena::destroy() {
+	m_buffer.destroy();
+	m_region = StreamingBuffer::Region{};
+	m_head = 0;
+}
+
+BufferArena& BufferArena::bind(Buffer::BufferType type) {
+	StateCache::get().bindBuffer(GLenum(type), m_buffer.id());
+	return *this;
+}
+
+BufferArena& BufferArena::unbind(Buffer::BufferType type) {
+	StateCache::get().bindBuffer(GLenum(type), 0);
+	return *this;
+}
+
+BufferArena::Slice BufferArena::allocate(u32 size, u32 alignment) {
+	if (!m_region.data || alignment == 0) {
+		return Slice{};
+	}
+
+	const u32 start = ((m_head + alignment - 1) / alignment) * alignment;
+	if (start + size > m_region.size) {
+		return Slice{};
+	}
+	m_head = start + size;
+
+	Slice slice;
+	slice.buffer = m_buffer.id();
+	slice.offset = m_region.offset + start;
+	slice.size = size;
+	slice.data = m_region.data + start;
+	return slice;
+}
+
+BufferArena& BufferArena::reset() {
+	if (m_region.data) {
+		m_buffer.end();
+		m_region = m_buffer.begin();
+	}
+	m_head = 0;
+	return *this;
+}
@@ -0,0 +1,67 @@
+#ifndef GFXE_ARENA_H
+#define GFXE_ARENA_H
+
+#include <algorithm>
+
+#include "buffer.h"
+
+// Linear allocator over a StreamingBuffer for per-frame transient data.
+// Slices are valid until the next reset(), which moves to the next frame region.
+class BufferArena {
+public:
+	struct Slice {
+		GLuint buffer{ 0 };
+		u32 offset{ 0 };
+		u32 size{ 0 };
+		u8* data{ nullptr };
+
+		bool valid() const { return data != nullptr; }
+
+		template <typename DataType>
+		DataType* as() const { return reinterpret_cast<DataType*>(data); }
+
+		void bind(Buffer::BufferType type, u32 bindingPoint) const;
+	};
+
+	BufferArena() = default;
+	~BufferArena() = default;
+
+	BufferArena& create(u32 frameSize, u32 framesInFlight = 3);
+	void destroy();
+
+	BufferArena& bind(Buffer::BufferType type);
+	BufferArena& unbind(Buffer::BufferType type);
+
+	Slice allocate(u32 size, u32 alignment = 4);
+	Slice allocateUniform(u32 size) { return allocate(size, m_uniformAlignment); }
+	Slice allocateStorage(u32 size) { return allocate(size, m_storageAlignment); }
+
+	template <typename DataType>
+	inline Slice push(const std::vector<DataType>& data, u32 alignment = alignof(DataType)) {
+		const u32 size = u32(sizeof(DataType) * data.size());
+		Slice slice = allocate(size, alignment);
+		if (slice.valid()) {
+			std::copy(data.begin(), data.end(), slice.as<DataType>());
+		}
+		return slice;
+	}
+
+	// Fences the slices handed out this frame and starts over in the next region.
+	BufferArena& reset();
+
+	GLuint id() const { return m_buffer.id(); }
+	u32 used() const { return m_head; }
+	u32 capacity() const { return m_buffer.regionSize(); }
+
+	u32 uniformAlignment() const { return m_uniformAlignment; }
+	u32 storageAlignment() const { return m_storageAlignment; }
+
+private:
+	StreamingBuffer m_buffer;
+	StreamingBuffer::Region m_region;
+
+	u32 m_head{ 0 };
+	u32 m_uniformAlignment{ 256 }, m_storageAlignment{ 256 };
+};
+
+#endif // GFXE_ARENA_H
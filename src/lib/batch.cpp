@@ -0,0 +1,137 @@
+#include "batch.h"
+#include "state.h"
+
+#include <cassert>
+
+DrawBatch& DrawBatch::create(u32 dataStride, u32 dataBinding) {
+	m_dataStride = dataStride;
+	m_dataBinding = dataBinding;
+
+	GLint align = 1;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &align);
+	m_dataAlignment = u32(align);
+
+	m_indirect.create(Buffer::DrawIndirectBuffer);
+	if (m_dataStride > 0) {
+		m_drawData.create(Buffer::ShaderStorageBuffer);
+	}
+	return *this;
+}
+
+void DrawBatch::destroy() {
+	m_indirect.destroy();
+	m_drawData.destroy();
+	clear();
+	m_spare.clear();
+}
+
+DrawBatch& DrawBatch::add(const Shader& shader, const VertexArray& vao, const DrawElementsIndirectCommand& cmd, const void* data) {
+	const u64 key = (u64(shader.activeId()) << 32) | u64(vao.id());
+
+	auto pos = m_bucketIndex.find(key);
+	u32 b;
+	if (pos == m_bucketIndex.end()) {
+		b = u32(m_buckets.size());
+		if (m_spare.empty()) {
+			m_buckets.push_back(Bucket{});
+		} else {
+			m_buckets.push_back(std::move(m_spare.back()));
+			m_spare.pop_back();
+		}
+		m_buckets.back().shader = &shader;
+		m_buckets.back().vao = &vao;
+		m_bucketIndex[key] = b;
+	} else {
+		b = pos->second;
+	}
+
+	Bucket& bucket = m_buckets[b];
+	DrawElementsIndirectCommand c = cmd;
+	if (m_dataStride > 0) {
+		// baseInstance carries the data index, which would shift the
+		// instanced attributes of a draw with more than one instance.
+		assert(cmd.instanceCount <= 1 && "DrawBatch: per-draw data needs single-instance draws");
+		c.baseInstance = u32(bucket.commands.size());
+	}
+	bucket.commands.push_back(c);
+
+	if (m_dataStride > 0) {
+		const size_t at = bucket.data.size();
+		bucket.data.resize(at + m_dataStride);
+		if (data) {
+			std::memcpy(&bucket.data[at], data, m_dataStride);
+		}
+	}
+	return *this;
+}
+
+DrawBatch& DrawBatch::clear() {
+	// Buckets don't outlive the frame: their shader or vertex array may be
+	// destroyed and its name reused. Their storage is kept for reuse.
+	for (auto&& bucket : m_buckets) {
+		bucket.shader = nullptr;
+		bucket.vao = nullptr;
+		bucket.commands.clear();
+		bucket.data.clear();
+		m_spare.push_back(std::move(bucket));
+	}
+	m_buckets.clear();
+	m_bucketIndex.clear();
+	return *this;
+}
+
+DrawBatch& DrawBatch::submit(PrimitiveType mode, DataType indexType) {
+	m_stats = Stats{};
+	m_commands.clear();
+	m_data.clear();
+
+	// Lay out every bucket back to back; data ranges start on the storage
+	// buffer offset alignment so each can be bound on its own.
+	std::vector<u32> dataOffsets(m_buckets.size(), 0);
+	for (u32 b = 0; b < m_buckets.size(); b++) {
+		const Bucket& bucket = m_buckets[b];
+		if (bucket.commands.empty()) continue;
+
+		m_commands.insert(m_commands.end(), bucket.commands.begin(), bucket.commands.end());
+		if (m_dataStride > 0) {
+			const size_t at = ((m_data.size() + m_dataAlignment - 1) / m_dataAlignment) * m_dataAlignment;
+			dataOffsets[b] = u32(at);
+			m_data.resize(at + bucket.data.size());
+			std::memcpy(&m_data[at], bucket.data.data(), bucket.data.size());
+		}
+	}
+
+	if (m_commands.empty()) {
+		return *this;
+	}
+
+	m_indirect.bind().update(m_commands, Buffer::StreamDraw);
+	if (m_dataStride > 0) {
+		m_drawData.bind().update(m_data, Buffer::StreamDraw);
+	}
+
+	u32 first = 0;
+	for (u32 b = 0; b < m_buckets.size(); b++) {
+		const Bucket& bucket = m_buckets[b];
+		const u32 count = u32(bucket.commands.size());
+		if (count == 0) continue;
+
+		bucket.shader->flush();
+		StateCache::get().useProgram(bucket.shader->activeId());
+		StateCache::get().bindVertexArray(bucket.vao->id());
+		StateCache::get().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect.id());
+		if (m_dataStride > 0) {
+			m_drawData.bindRange(m_dataBinding, dataOffsets[b], count * m_dataStride);
+		}
+
+		const void* offset = reinterpret_cast<const void*>(uintptr_t(first * sizeof(DrawElementsIndirectCommand)));
+		glMultiDrawElementsIndirect(mode, indexType, offset, count, 0);
+
+		first += count;
+		m_stats.draws += count;
+		m_stats.buckets++;
+		m_stats.multiDraws++;
+	}
+
+	return *this;
+}
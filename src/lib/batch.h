@@ -0,0 +1,73 @@
+#ifndef GFXE_BATCH_H
+#define GFXE_BATCH_H
+
+#include <vector>
+#include <unordered_map>
+
+#include "command.h"
+
+struct DrawElementsIndirectCommand {
+	u32 count;
+	u32 instanceCount;
+	u32 firstIndex;
+	i32 baseVertex;
+	u32 baseInstance;
+};
+
+// Collects indexed draws into an indirect buffer and issues one
+// glMultiDrawElementsIndirect per (program, vertex array) bucket.
+//
+// Per-draw data is packed into a shader storage buffer whose range for
+// each bucket is bound at dataBinding, so shaders index it with gl_DrawID
+// (GLSL 4.60 or ARB_shader_draw_parameters). With per-draw data,
+// baseInstance is set to the draw's index within its bucket for shaders
+// that cannot use gl_DrawID, so each draw must be a single instance.
+// Without it, commands are submitted as given.
+class DrawBatch {
+public:
+	struct Stats {
+		u32 draws{ 0 };
+		u32 buckets{ 0 };
+		u32 multiDraws{ 0 };
+	};
+
+	DrawBatch() = default;
+	~DrawBatch() = default;
+
+	DrawBatch& create(u32 dataStride = 0, u32 dataBinding = 0);
+	void destroy();
+
+	DrawBatch& add(const Shader& shader, const VertexArray& vao, const DrawElementsIndirectCommand& cmd, const void* data = nullptr);
+
+	template <typename DataType>
+	inline DrawBatch& add(const Shader& shader, const VertexArray& vao, const DrawElementsIndirectCommand& cmd, const DataType& data) {
+		return add(shader, vao, cmd, static_cast<const void*>(&data));
+	}
+
+	DrawBatch& submit(PrimitiveType mode = PrimitiveType::Triangles, DataType indexType = DataType::TypeUInt);
+	// Call once the frame's draws are submitted; drops every bucket.
+	DrawBatch& clear();
+
+	const Stats& stats() const { return m_stats; }
+
+private:
+	struct Bucket {
+		const Shader* shader{ nullptr };
+		const VertexArray* vao{ nullptr };
+		std::vector<DrawElementsIndirectCommand> commands;
+		std::vector<u8> data;
+	};
+
+	std::vector<Bucket> m_buckets, m_spare;
+	std::unordered_map<u64, u32> m_bucketIndex;
+
+	Buffer m_indirect, m_drawData;
+	std::vector<DrawElementsIndirectCommand> m_commands;
+	std::vector<u8> m_data;
+
+	u32 m_dataStride{ 0 }, m_dataBinding{ 0 }, m_dataAlignment{ 1 };
+
+	Stats m_stats;
+};
+
+#endif // GFXE_BATCH_H
@@ -0,0 +1,185 @@
+#include "block.h"
+#include "hash.h"
+
+#include <algorithm>
+
+BlockBuffer& BlockBuffer::create(Shader& shader, u64 blockHash, u32 binding, u32 regionCount) {
+	destroy();
+
+	const u32 b = shader.findBlock(blockHash);
+	if (b == Shader::InvalidIndex) {
+		return *this;
+	}
+
+	const Shader::BlockInfo& block = shader.blocks()[b];
+	const bool uniform = block.interface == Shader::UniformBufferBlock;
+
+	m_size = block.size;
+	m_binding = binding == Shader::InvalidIndex ? block.binding : binding;
+	if (m_binding != block.binding) {
+		if (uniform) shader.uniformBlockBinding(block.index, m_binding);
+		else shader.storageBlockBinding(block.index, m_binding);
+	}
+
+	// Members are reported as "Block.member" when the block has an instance name.
+	const std::string prefix = block.name + ".";
+	const auto& variables = uniform ? shader.uniforms() : shader.bufferVariables();
+	m_members.clear();
+	for (auto&& v : variables) {
+		if (v.blockIndex != i32(block.index)) continue;
+
+		Member m;
+		m.name = v.name.compare(0, prefix.size(), prefix) == 0 ? v.name.substr(prefix.size()) : v.name;
+		m.hash = hashString(m.name);
+		m.type = v.type;
+		m.offset = u32(v.offset);
+		m.arrayStride = u32(std::max(v.arrayStride, 0));
+		m.matrixStride = u32(std::max(v.matrixStride, 0));
+		m_members.push_back(m);
+	}
+	std::sort(m_members.begin(), m_members.end(), [](const Member& a, const Member& b) {
+		return a.hash < b.hash;
+	});
+
+	m_contents.assign(m_size, 0);
+	m_buffer.create(uniform ? Buffer::UniformBuffer : Buffer::ShaderStorageBuffer);
+	if (GLAD_GL_VERSION_4_4 && regionCount > 0) {
+		GLint align = 1;
+		glGetIntegerv(uniform ? GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT : GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &align);
+		align = std::max(align, 1);
+
+		m_regionSize = ((m_size + u32(align) - 1) / u32(align)) * u32(align);
+		m_regionCount = regionCount;
+
+		// Not coherent: flush() publishes exactly the bytes that changed.
+		const u32 size = m_regionSize * m_regionCount;
+		m_buffer.storage(size, Buffer::StorageMapWrite | Buffer::StorageMapPersistent);
+		m_mapping = m_buffer.mapRange<u8>(0, size, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+		if (m_mapping) {
+			std::memset(m_mapping, 0, size);
+			m_buffer.flushRange(0, size);
+		}
+	}
+	if (!m_mapping) {
+		// glBufferSubData is ordered against earlier draws, so one region will do.
+		m_regionSize = m_size;
+		m_regionCount = 1;
+		m_buffer.update(m_contents, Buffer::DynamicDraw);
+	}
+	m_current = 0;
+	m_fences.resize(m_regionCount);
+	m_stale.resize(m_regionCount);
+
+	return *this;
+}
+
+void BlockBuffer::destroy() {
+	if (m_mapping) {
+		m_buffer.unmap();
+	}
+	m_buffer.destroy();
+	for (auto&& fence : m_fences) {
+		fence.destroy();
+	}
+	m_fences.clear();
+	m_stale.clear();
+	m_contents.clear();
+	m_members.clear();
+	m_dirty.clear();
+	m_mapping = nullptr;
+	m_size = m_regionSize = m_regionCount = m_current = 0;
+	m_bound = false;
+}
+
+u32 BlockBuffer::find(u64 hash) const {
+	auto pos = std::lower_bound(m_members.begin(), m_members.end(), hash, [](const Member& m, u64 h) {
+		return m.hash < h;
+	});
+	if (pos == m_members.end() || pos->hash != hash) {
+		return Shader::InvalidIndex;
+	}
+	return u32(pos - m_members.begin());
+}
+
+BlockBuffer& BlockBuffer::write(u32 offset, const void* data, u32 size) {
+	if (!valid() || offset + size > m_size) {
+		return *this;
+	}
+	std::memcpy(&m_contents[offset], data, size);
+	return touch(offset, size);
+}
+
+BlockBuffer& BlockBuffer::touch(u32 offset, u32 size) {
+	if (size == 0 || offset >= m_size) {
+		return *this;
+	}
+	if (m_bound && m_mapping) {
+		advance();
+	}
+
+	const Range range{ offset, std::min(offset + size, m_size) };
+	if (m_mapping) {
+		std::memcpy(m_mapping + m_current * m_regionSize + range.begin, &m_contents[range.begin], range.end - range.begin);
+	}
+	m_dirty.push_back(range);
+	for (u32 r = 0; r < m_regionCount; r++) {
+		if (r != m_current) m_stale[r].push_back(range);
+	}
+	return *this;
+}
+
+void BlockBuffer::advance() {
+	// Pending writes belong to the region being left.
+	flush();
+	m_fences[m_current].signal();
+	m_current = (m_current + 1) % m_regionCount;
+	m_fences[m_current].wait();
+
+	// Bring the region up to date with what changed while it was in use.
+	u8* region = m_mapping + m_current * m_regionSize;
+	for (auto&& range : m_stale[m_current]) {
+		std::memcpy(region + range.begin, &m_contents[range.begin], range.end - range.begin);
+		m_dirty.push_back(range);
+	}
+	m_stale[m_current].clear();
+	m_bound = false;
+}
+
+BlockBuffer& BlockBuffer::flush() {
+	if (m_dirty.empty()) {
+		return *this;
+	}
+
+	std::sort(m_dirty.begin(), m_dirty.end(), [](const Range& a, const Range& b) {
+		return a.begin < b.begin;
+	});
+
+	// Merge overlapping and adjacent ranges so each span goes up once.
+	Range span = m_dirty[0];
+	auto send = [&](const Range& r) {
+		const u32 base = m_current * m_regionSize;
+		if (m_mapping) m_buffer.flushRange(base + r.begin, r.end - r.begin);
+		else m_buffer.updateRange(r.begin, r.end - r.begin, &m_contents[r.begin]);
+	};
+	for (size_t i = 1; i < m_dirty.size(); i++) {
+		if (m_dirty[i].begin <= span.end) {
+			span.end = std::max(span.end, m_dirty[i].end);
+		} else {
+			send(span);
+			span = m_dirty[i];
+		}
+	}
+	send(span);
+
+	m_dirty.clear();
+	return *this;
+}
+
+BlockBuffer& BlockBuffer::bind() {
+	if (!valid()) {
+		return *this;
+	}
+	m_buffer.bindRange(m_binding, m_current * m_regionSize, m_size);
+	m_bound = true;
+	return *this;
+}
@@ -0,0 +1,130 @@
+#ifndef GFXE_BLOCK_H
+#define GFXE_BLOCK_H
+
+#include <vector>
+#include <cstring>
+#include <initializer_list>
+
+#include "shader.h"
+#include "buffer.h"
+
+// Backing store for one uniform or storage block of a linked program. The
+// layout comes from reflection. The contents live in a persistently mapped
+// buffer split into fenced regions, one per frame in flight, and flush()
+// only sends the byte ranges that changed.
+//
+// Per frame: write, flush(), bind(), draw. The first write after a bind()
+// fences the region the GPU may still be reading and moves on to the next
+// one, bringing it up to date with what changed meanwhile, so bind() again
+// before drawing with new values.
+class BlockBuffer {
+public:
+	struct Member {
+		u64 hash; // of the name without the block prefix
+		std::string name;
+		GLenum type;
+		u32 offset;
+		u32 arrayStride;
+		u32 matrixStride;
+	};
+
+	BlockBuffer() = default;
+	~BlockBuffer() = default;
+
+	// Binds the block to `binding`, or keeps the program's own binding if
+	// none is given. Does nothing if the program has no such block.
+	BlockBuffer& create(Shader& shader, u64 blockHash, u32 binding = Shader::InvalidIndex, u32 regionCount = 3);
+	void destroy();
+
+	u32 find(u64 hash) const;
+
+	// Writes element `element` of a member. Matrices and arrays must already
+	// be laid out with the member's strides (vec4 columns under std140).
+	template <typename T>
+	BlockBuffer& set(u32 member, const T& value, u32 element = 0) {
+		if (member >= m_members.size()) return *this;
+		const Member& m = m_members[member];
+		return write(m.offset + element * m.arrayStride, &value, sizeof(T));
+	}
+
+	BlockBuffer& write(u32 offset, const void* data, u32 size);
+
+	// Publishes bytes changed through data().
+	BlockBuffer& touch(u32 offset, u32 size);
+
+	BlockBuffer& flush();
+	BlockBuffer& bind();
+
+	// The block's current contents on the CPU.
+	u8* data() { return m_contents.data(); }
+	u32 size() const { return m_size; }
+	u32 binding() const { return m_binding; }
+	bool valid() const { return m_size > 0; }
+
+	const std::vector<Member>& members() const { return m_members; }
+	Buffer& buffer() { return m_buffer; }
+
+private:
+	struct Range {
+		u32 begin, end;
+	};
+
+	Buffer m_buffer;
+	u8* m_mapping{ nullptr }; // null when falling back to glBufferSubData
+	std::vector<u8> m_contents;
+
+	u32 m_size{ 0 }, m_binding{ 0 };
+	u32 m_regionSize{ 0 }, m_regionCount{ 0 }, m_current{ 0 };
+	bool m_bound{ false };
+
+	std::vector<Member> m_members;
+	std::vector<Range> m_dirty;              // current region, not yet flushed
+	std::vector<std::vector<Range>> m_stale; // other regions, changed since they were used
+	std::vector<GpuFence> m_fences;
+
+	void advance();
+};
+
+// A BlockBuffer viewed as a C++ struct. validate() checks the struct's
+// member offsets against the linked program, after which members can be
+// written in place:
+//
+//   mirror.validate({ { "viewProj"_h, offsetof(Camera, viewProj) } });
+//   mirror.set(&Camera::viewProj, matrix).flush();
+template <typename Struct>
+class BlockMirror : public BlockBuffer {
+public:
+	struct Field {
+		u64 hash;
+		u32 offset;
+	};
+
+	// False if the block is smaller than Struct or any field is missing
+	// from the block or sits at a different offset.
+	bool validate(std::initializer_list<Field> fields) const {
+		if (!valid() || sizeof(Struct) > size()) return false;
+		for (auto&& field : fields) {
+			const u32 m = find(field.hash);
+			if (m == Shader::InvalidIndex || members()[m].offset != field.offset) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <typename M>
+	BlockMirror& set(M Struct::*member, const M& value) {
+		if (!valid() || sizeof(Struct) > size()) return *this;
+		Struct* s = reinterpret_cast<Struct*>(data());
+		const u32 offset = u32(reinterpret_cast<u8*>(&(s->*member)) - data());
+		write(offset, &value, sizeof(M));
+		return *this;
+	}
+
+	using BlockBuffer::set;
+
+	// Direct access; report what was changed with touch().
+	Struct* operator->() { return reinterpret_cast<Struct*>(data()); }
+};
+
+#endif // GFXE_BLOCK_H
@@ -1,9 +1,12 @@
 #include "buffer.h"
+#include "state.h"
 
 #include <iostream>
+#include <algorithm>
 
 void Buffer::destroy() {
 	if (m_id) {
+		StateCache::get().forgetBuffer(m_id);
 		glDeleteBuffers(1, &m_id);
 		m_id = 0;
 	}
@@ -11,40 +14,186 @@ void Buffer::destroy() {
 
 Buffer& Buffer::create(BufferType type) {
 	m_type = type;
-	glGenBuffers(1, &m_id);
+	if (Caps::directStateAccess()) {
+		glCreateBuffers(1, &m_id);
+	} else {
+		glGenBuffers(1, &m_id);
+	}
 	return *this;
 }
 
 Buffer& Buffer::bind() {
-	glBindBuffer(GLenum(m_type), m_id);
+	StateCache::get().bindBuffer(GLenum(m_type), m_id);
 	return *this;
 }
 
 Buffer& Buffer::unbind() {
-	glBindBuffer(GLenum(m_type), 0);
+	StateCache::get().bindBuffer(GLenum(m_type), 0);
 	return *this;
 }
 
 Buffer& Buffer::bindBase(u32 bindingPoint) {
-	glBindBufferBase(GLenum(m_type), bindingPoint, m_id);
+	StateCache::get().bindBufferBase(GLenum(m_type), bindingPoint, m_id);
+	return *this;
+}
+
+Buffer& Buffer::bindRange(u32 bindingPoint, u32 offset, u32 size) {
+	StateCache::get().bindBufferRange(GLenum(m_type), bindingPoint, m_id, offset, size);
+	return *this;
+}
+
+Buffer& Buffer::storage(u32 size, u32 flags, const void* data) {
+	if (Caps::directStateAccess()) {
+		glNamedBufferStorage(m_id, size, data, flags);
+	} else {
+		bind();
+		glBufferStorage(GLenum(m_type), size, data, flags);
+	}
+	m_size = size;
+	return *this;
+}
+
+Buffer& Buffer::updateRange(u32 offset, u32 size, const void* data) {
+	if (Caps::directStateAccess()) {
+		glNamedBufferSubData(m_id, offset, size, data);
+	} else {
+		bind();
+		glBufferSubData(GLenum(m_type), offset, size, data);
+	}
+	return *this;
+}
+
+Buffer& Buffer::flushRange(u32 offset, u32 size) {
+	if (Caps::directStateAccess()) {
+		glFlushMappedNamedBufferRange(m_id, offset, size);
+	} else {
+		bind();
+		glFlushMappedBufferRange(GLenum(m_type), offset, size);
+	}
+	return *this;
+}
+
+Buffer& Buffer::clear() {
+	if (Caps::directStateAccess()) {
+		glClearNamedBufferData(m_id, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	} else {
+		bind();
+		glClearBufferData(GLenum(m_type), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	}
 	return *this;
 }
 
 void Buffer::unmap() {
-	glUnmapBuffer(GLenum(m_type));
+	if (Caps::directStateAccess()) {
+		glUnmapNamedBuffer(m_id);
+	} else {
+		glUnmapBuffer(GLenum(m_type));
+	}
+}
+
+static u32 alignUp(u32 value, u32 alignment) {
+	return ((value + alignment - 1) / alignment) * alignment;
+}
+
+StreamingBuffer& StreamingBuffer::create(Buffer::BufferType type, u32 regionSize, u32 regionCount) {
+	if (!GLAD_GL_VERSION_4_4 || regionCount == 0) {
+		return *this;
+	}
+
+	GLint uboAlign = 1, ssboAlign = 1;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlign);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssboAlign);
+
+	m_regionSize = alignUp(regionSize, u32(std::max(uboAlign, ssboAlign)));
+	m_regionCount = regionCount;
+	m_current = 0;
+	m_fences.clear();
+	m_fences.resize(regionCount);
+
+	const u32 flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const u32 size = m_regionSize * m_regionCount;
+
+	m_buffer.create(type).storage(size, flags);
+	m_data = m_buffer.mapRange<u8>(0, size, flags);
+	if (!m_data) {
+		destroy();
+	}
+
+	return *this;
+}
+
+void StreamingBuffer::destroy() {
+	for (auto&& fence : m_fences) {
+		fence.destroy();
+	}
+	m_fences.clear();
+	m_buffer.destroy();
+	m_data = nullptr;
+	m_regionSize = m_regionCount = m_current = 0;
+}
+
+StreamingBuffer& StreamingBuffer::bind() {
+	m_buffer.bind();
+	return *this;
+}
+
+StreamingBuffer& StreamingBuffer::unbind() {
+	m_buffer.unbind();
+	return *this;
+}
+
+StreamingBuffer& StreamingBuffer::bindBase(u32 bindingPoint) {
+	if (!valid()) return *this;
+	m_buffer.bindRange(bindingPoint, m_current * m_regionSize, m_regionSize);
+	return *this;
+}
+
+StreamingBuffer::Region StreamingBuffer::begin() {
+	if (!valid()) return Region{};
+	m_fences[m_current].wait();
+	return current();
+}
+
+StreamingBuffer& StreamingBuffer::end() {
+	if (!valid()) return *this;
+	m_fences[m_current].signal();
+	m_current = (m_current + 1) % m_regionCount;
+	return *this;
+}
+
+StreamingBuffer::Region StreamingBuffer::current() const {
+	Region region;
+	region.offset = m_current * m_regionSize;
+	region.size = m_regionSize;
+	region.data = m_data ? m_data + region.offset : nullptr;
+	return region;
 }
 
 VertexArray& VertexArray::create() {
-	glGenVertexArrays(1, &m_id);
+	if (Caps::directStateAccess()) {
+		glCreateVertexArrays(1, &m_id);
+	} else {
+		glGenVertexArrays(1, &m_id);
+	}
 	return *this;
 }
 
 VertexArray& VertexArray::bind() {
-	glBindVertexArray(m_id);
+	StateCache::get().bindVertexArray(m_id);
 	return *this;
 }
 
 VertexArray& VertexArray::unbind() {
-	glBindVertexArray(0);
+	StateCache::get().bindVertexArray(0);
+	return *this;
+}
+
+VertexArray& VertexArray::elementBuffer(const Buffer& buffer) {
+	if (Caps::directStateAccess()) {
+		glVertexArrayElementBuffer(m_id, buffer.id());
+	} else {
+		bind();
+		StateCache::get().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.id());
+	}
 	return *this;
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 
 #include "integer.h"
 #include "glad/glad.h"
+#include "sync.h"
+#include "caps.h"
 
 class Buffer {
 public:
@@ -15,7 +17,9 @@ public:
 		ArrayBuffer = GL_ARRAY_BUFFER,
 		ElementBuffer = GL_ELEMENT_ARRAY_BUFFER,
 		UniformBuffer = GL_UNIFORM_BUFFER,
-		ShaderStorageBuffer = GL_SHADER_STORAGE_BUFFER
+		ShaderStorageBuffer = GL_SHADER_STORAGE_BUFFER,
+		DrawIndirectBuffer = GL_DRAW_INDIRECT_BUFFER,
+		AtomicCounterBuffer = GL_ATOMIC_COUNTER_BUFFER
 	};
 
 	enum BufferUsage {
@@ -36,6 +40,15 @@ public:
 		AccessReadWrite = GL_READ_WRITE
 	};
 
+	enum BufferStorageFlags {
+		StorageDynamic = GL_DYNAMIC_STORAGE_BIT,
+		StorageClient = GL_CLIENT_STORAGE_BIT,
+		StorageMapRead = GL_MAP_READ_BIT,
+		StorageMapWrite = GL_MAP_WRITE_BIT,
+		StorageMapPersistent = GL_MAP_PERSISTENT_BIT,
+		StorageMapCoherent = GL_MAP_COHERENT_BIT
+	};
+
 	Buffer() = default;
 	~Buffer() = default;
 
@@ -46,34 +59,116 @@ public:
 	Buffer& unbind();
 
 	Buffer& bindBase(u32 bindingPoint);
+	Buffer& bindRange(u32 bindingPoint, u32 offset, u32 size);
+
+	Buffer& storage(u32 size, u32 flags, const void* data = nullptr);
+	Buffer& updateRange(u32 offset, u32 size, const void* data);
+
+	// Makes CPU writes to a range mapped with GL_MAP_FLUSH_EXPLICIT_BIT visible.
+	Buffer& flushRange(u32 offset, u32 size);
+
+	// Zeroes the whole data store on the GPU.
+	Buffer& clear();
 
 	template <typename DataType>
 	inline Buffer& update(const std::vector<DataType>& data, BufferUsage usage = StaticDraw, i32 offset = 0) {
 		const size_t size = sizeof(DataType) * data.size();
+		const bool dsa = Caps::directStateAccess();
 		if (size > m_size) {
-			glBufferData(GLenum(m_type), size, data.data(), GLenum(usage));
+			if (dsa) glNamedBufferData(m_id, size, data.data(), GLenum(usage));
+			else glBufferData(GLenum(m_type), size, data.data(), GLenum(usage));
 			m_size = size;
 			m_usage = usage;
 		} else {
-			glBufferSubData(GLenum(m_type), offset, size, data.data());
+			if (dsa) glNamedBufferSubData(m_id, offset, size, data.data());
+			else glBufferSubData(GLenum(m_type), offset, size, data.data());
 		}
 		return *this;
 	}
 
 	template <typename DataType>
 	inline DataType* map(BufferAccess access = AccessReadWrite) {
+		if (Caps::directStateAccess()) {
+			return (DataType*) glMapNamedBuffer(m_id, GLenum(access));
+		}
 		return (DataType*) glMapBuffer(GLenum(m_type), GLenum(access));
 	}
 
+	// Unlike map(), binds the buffer itself when DSA is unavailable.
+	template <typename DataType>
+	inline DataType* mapRange(u32 offset, u32 size, u32 flags) {
+		if (Caps::directStateAccess()) {
+			return (DataType*) glMapNamedBufferRange(m_id, offset, size, flags);
+		}
+		bind();
+		return (DataType*) glMapBufferRange(GLenum(m_type), offset, size, flags);
+	}
+
 	void unmap();
 
 	GLuint id() const { return m_id; }
+	BufferType type() const { return m_type; }
+	u32 size() const { return m_size; }
+
+	Buffer& markUsed(GpuTimeline& timeline) { m_lastUse = timeline.pending(); return *this; }
+	u64 lastUse() const { return m_lastUse; }
 
 private:
 	GLuint m_id{ 0 };
 	BufferType m_type;
 	BufferUsage m_usage;
 	u32 m_size{ 0 };
+	u64 m_lastUse{ 0 };
+};
+
+// Persistently mapped buffer split into N regions, one per frame in flight.
+// The CPU writes into the current region while the GPU reads the others;
+// a region is only waited on when it comes around again still in use.
+class StreamingBuffer {
+public:
+	struct Region {
+		u8* data{ nullptr };
+		u32 offset{ 0 };
+		u32 size{ 0 };
+
+		template <typename DataType>
+		DataType* as() { return reinterpret_cast<DataType*>(data); }
+	};
+
+	StreamingBuffer() = default;
+	~StreamingBuffer() = default;
+
+	// Needs GL 4.4 and at least one region; check valid() afterwards. An
+	// invalid buffer hands out empty regions and ignores end().
+	StreamingBuffer& create(Buffer::BufferType type, u32 regionSize, u32 regionCount = 3);
+	void destroy();
+
+	bool valid() const { return m_data != nullptr; }
+
+	StreamingBuffer& bind();
+	StreamingBuffer& unbind();
+
+	// Binds the current region to an indexed binding point.
+	StreamingBuffer& bindBase(u32 bindingPoint);
+
+	// Returns the region for this frame, waiting only if the GPU still reads it.
+	Region begin();
+
+	// Fences the current region and advances to the next one.
+	StreamingBuffer& end();
+
+	Region current() const;
+
+	GLuint id() const { return m_buffer.id(); }
+	u32 regionSize() const { return m_regionSize; }
+	u32 regionCount() const { return m_regionCount; }
+
+private:
+	Buffer m_buffer;
+	u8* m_data{ nullptr };
+
+	u32 m_regionSize{ 0 }, m_regionCount{ 0 }, m_current{ 0 };
+	std::vector<GpuFence> m_fences;
 };
 
 enum DataType {
@@ -85,7 +180,26 @@ enum DataType {
 	TypeUInt = GL_UNSIGNED_INT,
 	TypeFloat = GL_FLOAT,
 	TypeHalfFloat = GL_HALF_FLOAT,
-	TypeFixed = GL_FIXED
+	TypeFixed = GL_FIXED,
+	TypeInt2101010Rev = GL_INT_2_10_10_10_REV,
+	TypeUInt2101010Rev = GL_UNSIGNED_INT_2_10_10_10_REV
+};
+
+class VertexArray {
+public:
+	VertexArray() = default;
+	~VertexArray();
+
+	VertexArray& create();
+	VertexArray& bind();
+	VertexArray& unbind();
+
+	VertexArray& elementBuffer(const Buffer& buffer);
+
+	GLuint id() const { return m_id; }
+
+private:
+	GLuint m_id;
 };
 
 template <size_t Stride>
@@ -95,6 +209,8 @@ public:
 		DataType type;
 		u8 size;
 		bool normalized;
+		bool integer;
+		u32 location;
 	};
 
 	using FieldList = std::vector<Field>;
@@ -106,28 +222,90 @@ public:
 		field.type = type;
 		field.size = size;
 		field.normalized = normalized;
+		field.integer = false;
+		field.location = m_nextLocation++;
 		m_fields.push_back(field);
 		return *this;
 	}
 
+	// Integer attribute, read as ivec/uvec in the shader without conversion.
+	VertexFormat& addInteger(u8 size, DataType type) {
+		add(size, type);
+		m_fields.back().integer = true;
+		return *this;
+	}
+
+	// Attribute location for the next field; later fields follow on from it.
+	// Lets a second format (e.g. per-instance data) share a VAO with the first.
+	VertexFormat& location(u32 loc) {
+		m_nextLocation = loc;
+		return *this;
+	}
+
+	// Advance once every `divisor` instances instead of once per vertex.
+	VertexFormat& divisor(u32 divisor) {
+		m_divisor = divisor;
+		return *this;
+	}
+
 	void enable() {
-		u32 off = 0, i = 0;
+		u32 off = 0;
+		for (auto&& field : m_fields) {
+			const void* ptr = reinterpret_cast<const void*>(uintptr_t(off));
+			glEnableVertexAttribArray(field.location);
+			if (field.integer) {
+				glVertexAttribIPointer(field.location, field.size, field.type, Stride, ptr);
+			} else {
+				glVertexAttribPointer(field.location, field.size, field.type, field.normalized, Stride, ptr);
+			}
+			glVertexAttribDivisor(field.location, m_divisor);
+			off += getFieldSize(field);
+		}
+	}
+
+	// Separate attribute format setup, sourcing all fields from one buffer
+	// binding. Uses the DSA entry points when available, so the VAO and
+	// buffer need not be bound. Formats on different bindings can be
+	// combined in one VAO, each with its own divisor.
+	void enable(VertexArray& vao, const Buffer& buffer, u32 binding = 0, u32 offset = 0) {
+		const bool dsa = Caps::directStateAccess();
+		if (!dsa) vao.bind();
+
+		u32 off = 0;
 		for (auto&& field : m_fields) {
-			glEnableVertexAttribArray(i);
-			glVertexAttribPointer(i, field.size, field.type, field.normalized, Stride, (void*)off);
-			i++;
-			off += getDataTypeSize(field.type) * field.size;
+			const u32 i = field.location;
+			if (dsa) {
+				glEnableVertexArrayAttrib(vao.id(), i);
+				if (field.integer) glVertexArrayAttribIFormat(vao.id(), i, field.size, field.type, off);
+				else glVertexArrayAttribFormat(vao.id(), i, field.size, field.type, field.normalized, off);
+				glVertexArrayAttribBinding(vao.id(), i, binding);
+			} else {
+				glEnableVertexAttribArray(i);
+				if (field.integer) glVertexAttribIFormat(i, field.size, field.type, off);
+				else glVertexAttribFormat(i, field.size, field.type, field.normalized, off);
+				glVertexAttribBinding(i, binding);
+			}
+			off += getFieldSize(field);
+		}
+
+		if (dsa) {
+			glVertexArrayVertexBuffer(vao.id(), binding, buffer.id(), offset, Stride);
+			glVertexArrayBindingDivisor(vao.id(), binding, m_divisor);
+		} else {
+			glBindVertexBuffer(binding, buffer.id(), offset, Stride);
+			glVertexBindingDivisor(binding, m_divisor);
 		}
 	}
 
 	void disable() {
-		for (u32 i = 0; i < m_fields.size(); i++) {
-			glDisableVertexAttribArray(i);
+		for (auto&& field : m_fields) {
+			glDisableVertexAttribArray(field.location);
 		}
 	}
 
 private:
 	FieldList m_fields;
+	u32 m_nextLocation{ 0 }, m_divisor{ 0 };
 
 	inline size_t getDataTypeSize(DataType type) {
 		switch (type) {
@@ -140,22 +318,17 @@ private:
 			case DataType::TypeFloat: return 4;
 			case DataType::TypeHalfFloat: return 2;
 			case DataType::TypeFixed: return 4;
+			// Packed: the whole 4-component attribute is one 32-bit word.
+			case DataType::TypeInt2101010Rev:
+			case DataType::TypeUInt2101010Rev: return 4;
 			default: return 1;
 		}
 	}
-};
 
-class VertexArray {
-public:
-	VertexArray() = default;
-	~VertexArray();
-
-	VertexArray& create();
-	VertexArray& bind();
-	VertexArray& unbind();
-
-private:
-	GLuint m_id;
+	inline size_t getFieldSize(const Field& field) {
+		const bool packed = field.type == DataType::TypeInt2101010Rev || field.type == DataType::TypeUInt2101010Rev;
+		return packed ? getDataTypeSize(field.type) : getDataTypeSize(field.type) * field.size;
+	}
 };
 
 #endif // GFXE_BUFFER_H
\ No newline at end of file
@@ -0,0 +1,11 @@
+#include "caps.h"
+
+bool Caps::s_directStateAccess = false;
+
+void Caps::detect() {
+	s_directStateAccess = GLAD_GL_VERSION_4_5;
+}
+
+void Caps::useDirectStateAccess(bool enable) {
+	s_directStateAccess = enable && GLAD_GL_VERSION_4_5;
+}
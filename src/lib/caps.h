@@ -0,0 +1,18 @@
+#ifndef GFXE_CAPS_H
+#define GFXE_CAPS_H
+
+#include "glad/glad.h"
+
+// Runtime-selected code paths. Call detect() once the GL loader has run.
+class Caps {
+public:
+	static void detect();
+
+	static bool directStateAccess() { return s_directStateAccess; }
+	static void useDirectStateAccess(bool enable);
+
+private:
+	static bool s_directStateAccess;
+};
+
+#endif // GFXE_CAPS_H
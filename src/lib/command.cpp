@@ -0,0 +1,276 @@
+#include "command.h"
+#include "state.h"
+
+CommandBuffer& CommandBuffer::bind(const Shader& shader) {
+	GLuint id = shader.activeId();
+	return push(CmdBindProgram, id);
+}
+
+CommandBuffer& CommandBuffer::bind(const VertexArray& vao) {
+	GLuint id = vao.id();
+	return push(CmdBindVertexArray, id);
+}
+
+CommandBuffer& CommandBuffer::bind(const Texture& texture, u32 slot) {
+	BindTexturePacket p;
+	p.unit = slot;
+	p.target = texture.type();
+	p.id = texture.id();
+	return push(CmdBindTexture, p);
+}
+
+CommandBuffer& CommandBuffer::bind(const Buffer& buffer) {
+	BindBufferPacket p{};
+	p.target = buffer.type();
+	p.id = buffer.id();
+	return push(CmdBindBuffer, p);
+}
+
+CommandBuffer& CommandBuffer::bindBase(const Buffer& buffer, u32 bindingPoint) {
+	BindBufferPacket p{};
+	p.target = buffer.type();
+	p.id = buffer.id();
+	p.index = bindingPoint;
+	return push(CmdBindBufferBase, p);
+}
+
+CommandBuffer& CommandBuffer::bindRange(GLenum target, GLuint buffer, u32 bindingPoint, u32 offset, u32 size) {
+	BindBufferPacket p;
+	p.target = target;
+	p.id = buffer;
+	p.index = bindingPoint;
+	p.offset = offset;
+	p.size = size;
+	return push(CmdBindBufferRange, p);
+}
+
+CommandBuffer& CommandBuffer::bind(const FrameBuffer& fbo, FrameBufferTarget target) {
+	BindFramebufferPacket p;
+	p.target = target;
+	p.id = fbo.id();
+	push(CmdBindFramebuffer, p);
+	return viewport(0, 0, fbo.width(), fbo.height());
+}
+
+CommandBuffer& CommandBuffer::bindDefaultFramebuffer(FrameBufferTarget target) {
+	BindFramebufferPacket p;
+	p.target = target;
+	p.id = 0;
+	return push(CmdBindFramebuffer, p);
+}
+
+CommandBuffer& CommandBuffer::viewport(i32 x, i32 y, i32 w, i32 h) {
+	return push(CmdViewport, ViewportPacket{ x, y, w, h });
+}
+
+CommandBuffer& CommandBuffer::clearColor(f32 r, f32 g, f32 b, f32 a) {
+	return push(CmdClearColor, ClearColorPacket{ r, g, b, a });
+}
+
+CommandBuffer& CommandBuffer::clear(u32 mask) {
+	return push(CmdClear, mask);
+}
+
+CommandBuffer& CommandBuffer::pushUniform(i32 loc, UniformType type, const f32* v, u32 floats, u32 count, bool transpose) {
+	UniformPacket p;
+	p.loc = loc;
+	p.type = type;
+	p.transpose = transpose ? 1 : 0;
+	p.count = count;
+	return push(CmdUniform, p, v, u32(sizeof(f32) * floats * count));
+}
+
+CommandBuffer& CommandBuffer::uniform(i32 loc, i32 v) {
+	UniformPacket p;
+	p.loc = loc;
+	p.type = UniformInt;
+	p.transpose = 0;
+	p.count = 1;
+	return push(CmdUniform, p, &v, sizeof(i32));
+}
+
+CommandBuffer& CommandBuffer::uniform(i32 loc, f32 v) {
+	return pushUniform(loc, UniformFloat, &v, 1);
+}
+
+CommandBuffer& CommandBuffer::uniform(i32 loc, f32 x, f32 y) {
+	const f32 v[] = { x, y };
+	return pushUniform(loc, UniformVec2, v, 2);
+}
+
+CommandBuffer& CommandBuffer::uniform(i32 loc, f32 x, f32 y, f32 z) {
+	const f32 v[] = { x, y, z };
+	return pushUniform(loc, UniformVec3, v, 3);
+}
+
+CommandBuffer& CommandBuffer::uniform(i32 loc, f32 x, f32 y, f32 z, f32 w) {
+	const f32 v[] = { x, y, z, w };
+	return pushUniform(loc, UniformVec4, v, 4);
+}
+
+CommandBuffer& CommandBuffer::uniformMat3(i32 loc, const f32* v, u32 count, bool transpose) {
+	return pushUniform(loc, UniformMat3, v, 9, count, transpose);
+}
+
+CommandBuffer& CommandBuffer::uniformMat4(i32 loc, const f32* v, u32 count, bool transpose) {
+	return pushUniform(loc, UniformMat4, v, 16, count, transpose);
+}
+
+CommandBuffer& CommandBuffer::drawArrays(PrimitiveType mode, u32 first, u32 count, u32 instances) {
+	return push(CmdDrawArrays, DrawArraysPacket{ GLenum(mode), first, count, instances });
+}
+
+CommandBuffer& CommandBuffer::drawElements(
+	PrimitiveType mode, u32 count,
+	DataType indexType,
+	u32 offset, u32 instances, i32 baseVertex
+) {
+	DrawElementsPacket p;
+	p.mode = mode;
+	p.count = count;
+	p.type = indexType;
+	p.offset = offset;
+	p.instances = instances;
+	p.baseVertex = baseVertex;
+	return push(CmdDrawElements, p);
+}
+
+CommandBuffer& CommandBuffer::blit(
+	int sx0, int sy0, int sx1, int sy1,
+	int dx0, int dy0, int dx1, int dy1,
+	ClearBufferMask mask,
+	TextureFilter filter
+) {
+	BlitPacket p;
+	p.src[0] = sx0; p.src[1] = sy0; p.src[2] = sx1; p.src[3] = sy1;
+	p.dst[0] = dx0; p.dst[1] = dy0; p.dst[2] = dx1; p.dst[3] = dy1;
+	p.mask = mask;
+	p.filter = filter;
+	return push(CmdBlit, p);
+}
+
+CommandBuffer& CommandBuffer::dispatch(u32 x, u32 y, u32 z) {
+	return push(CmdDispatch, DispatchPacket{ x, y, z });
+}
+
+CommandBuffer& CommandBuffer::memoryBarrier(u32 barriers) {
+	return push(CmdMemoryBarrier, barriers);
+}
+
+CommandBuffer& CommandBuffer::append(const CommandBuffer& other) {
+	m_data.insert(m_data.end(), other.m_data.begin(), other.m_data.end());
+	m_count += other.m_count;
+	return *this;
+}
+
+template <typename Packet>
+static Packet read(const u8* data) {
+	Packet p;
+	std::memcpy(&p, data, sizeof(Packet));
+	return p;
+}
+
+void CommandBuffer::submitUniform(const u8* data) {
+	auto p = read<UniformPacket>(data);
+	const u8* values = data + sizeof(UniformPacket);
+
+	f32 v[16];
+	switch (p.type) {
+		case UniformInt: {
+			i32 i;
+			std::memcpy(&i, values, sizeof(i32));
+			glUniform1i(p.loc, i);
+		} break;
+		case UniformFloat:
+			std::memcpy(v, values, sizeof(f32));
+			glUniform1f(p.loc, v[0]);
+			break;
+		case UniformVec2:
+			std::memcpy(v, values, sizeof(f32) * 2);
+			glUniform2f(p.loc, v[0], v[1]);
+			break;
+		case UniformVec3:
+			std::memcpy(v, values, sizeof(f32) * 3);
+			glUniform3f(p.loc, v[0], v[1], v[2]);
+			break;
+		case UniformVec4:
+			std::memcpy(v, values, sizeof(f32) * 4);
+			glUniform4f(p.loc, v[0], v[1], v[2], v[3]);
+			break;
+		case UniformMat3:
+			glUniformMatrix3fv(p.loc, p.count, p.transpose, reinterpret_cast<const f32*>(values));
+			break;
+		case UniformMat4:
+			glUniformMatrix4fv(p.loc, p.count, p.transpose, reinterpret_cast<const f32*>(values));
+			break;
+	}
+}
+
+void CommandBuffer::submit() const {
+	StateCache& cache = StateCache::get();
+
+	size_t at = 0;
+	while (at < m_data.size()) {
+		Header header = read<Header>(&m_data[at]);
+		const u8* data = &m_data[at + sizeof(Header)];
+		at += sizeof(Header) + header.size;
+
+		switch (header.type) {
+			case CmdBindProgram: cache.useProgram(read<GLuint>(data)); break;
+			case CmdBindVertexArray: cache.bindVertexArray(read<GLuint>(data)); break;
+			case CmdBindTexture: {
+				auto p = read<BindTexturePacket>(data);
+				cache.bindTexture(p.unit, p.target, p.id);
+			} break;
+			case CmdBindBuffer: {
+				auto p = read<BindBufferPacket>(data);
+				cache.bindBuffer(p.target, p.id);
+			} break;
+			case CmdBindBufferBase: {
+				auto p = read<BindBufferPacket>(data);
+				cache.bindBufferBase(p.target, p.index, p.id);
+			} break;
+			case CmdBindBufferRange: {
+				auto p = read<BindBufferPacket>(data);
+				cache.bindBufferRange(p.target, p.index, p.id, p.offset, p.size);
+			} break;
+			case CmdBindFramebuffer: {
+				auto p = read<BindFramebufferPacket>(data);
+				cache.bindFramebuffer(p.target, p.id);
+			} break;
+			case CmdViewport: {
+				auto p = read<ViewportPacket>(data);
+				cache.viewport(p.x, p.y, p.w, p.h);
+			} break;
+			case CmdClearColor: {
+				auto p = read<ClearColorPacket>(data);
+				glClearColor(p.r, p.g, p.b, p.a);
+			} break;
+			case CmdClear: glClear(read<u32>(data)); break;
+			case CmdUniform: submitUniform(data); break;
+			case CmdDrawArrays: {
+				auto p = read<DrawArraysPacket>(data);
+				if (p.instances == 1) glDrawArrays(p.mode, p.first, p.count);
+				else glDrawArraysInstanced(p.mode, p.first, p.count, p.instances);
+			} break;
+			case CmdDrawElements: {
+				auto p = read<DrawElementsPacket>(data);
+				const void* offset = reinterpret_cast<const void*>(uintptr_t(p.offset));
+				glDrawElementsInstancedBaseVertex(p.mode, p.count, p.type, offset, p.instances, p.baseVertex);
+			} break;
+			case CmdBlit: {
+				auto p = read<BlitPacket>(data);
+				glBlitFramebuffer(
+					p.src[0], p.src[1], p.src[2], p.src[3],
+					p.dst[0], p.dst[1], p.dst[2], p.dst[3],
+					p.mask, p.filter
+				);
+			} break;
+			case CmdDispatch: {
+				auto p = read<DispatchPacket>(data);
+				glDispatchCompute(p.x, p.y, p.z);
+			} break;
+			case CmdMemoryBarrier: glMemoryBarrier(read<u32>(data)); break;
+		}
+	}
+}
@@ -0,0 +1,157 @@
+#ifndef GFXE_COMMAND_H
+#define GFXE_COMMAND_H
+
+#include <vector>
+#include <cstring>
+
+#include "integer.h"
+#include "glad/glad.h"
+
+#include "buffer.h"
+#include "texture.h"
+#include "framebuffer.h"
+#include "shader.h"
+
+enum PrimitiveType {
+	Points = GL_POINTS,
+	Lines = GL_LINES,
+	LineStrip = GL_LINE_STRIP,
+	Triangles = GL_TRIANGLES,
+	TriangleStrip = GL_TRIANGLE_STRIP,
+	TriangleFan = GL_TRIANGLE_FAN
+};
+
+// Records GL work as a flat stream of POD packets without touching GL, so
+// any thread can encode into its own buffer. submit() replays the stream
+// on the thread that owns the context.
+// Uniform locations must be resolved up front; Shader::get may call into GL.
+class CommandBuffer {
+public:
+	enum CommandType : u16 {
+		CmdBindProgram = 0,
+		CmdBindVertexArray,
+		CmdBindTexture,
+		CmdBindBuffer,
+		CmdBindBufferBase,
+		CmdBindBufferRange,
+		CmdBindFramebuffer,
+		CmdViewport,
+		CmdClearColor,
+		CmdClear,
+		CmdUniform,
+		CmdDrawArrays,
+		CmdDrawElements,
+		CmdBlit,
+		CmdDispatch,
+		CmdMemoryBarrier
+	};
+
+	enum UniformType : u16 {
+		UniformInt = 0,
+		UniformFloat,
+		UniformVec2,
+		UniformVec3,
+		UniformVec4,
+		UniformMat3,
+		UniformMat4
+	};
+
+	CommandBuffer() = default;
+	~CommandBuffer() = default;
+
+	CommandBuffer& bind(const Shader& shader);
+	CommandBuffer& bind(const VertexArray& vao);
+	CommandBuffer& bind(const Texture& texture, u32 slot = 0);
+	CommandBuffer& bind(const Buffer& buffer);
+	CommandBuffer& bindBase(const Buffer& buffer, u32 bindingPoint);
+	CommandBuffer& bindRange(GLenum target, GLuint buffer, u32 bindingPoint, u32 offset, u32 size);
+	CommandBuffer& bind(const FrameBuffer& fbo, FrameBufferTarget target = FrameBufferTarget::DRFrameBuffer);
+	CommandBuffer& bindDefaultFramebuffer(FrameBufferTarget target = FrameBufferTarget::DRFrameBuffer);
+
+	CommandBuffer& viewport(i32 x, i32 y, i32 w, i32 h);
+	CommandBuffer& clearColor(f32 r, f32 g, f32 b, f32 a);
+	CommandBuffer& clear(u32 mask);
+
+	CommandBuffer& uniform(i32 loc, i32 v);
+	CommandBuffer& uniform(i32 loc, f32 v);
+	CommandBuffer& uniform(i32 loc, f32 x, f32 y);
+	CommandBuffer& uniform(i32 loc, f32 x, f32 y, f32 z);
+	CommandBuffer& uniform(i32 loc, f32 x, f32 y, f32 z, f32 w);
+	CommandBuffer& uniformMat3(i32 loc, const f32* v, u32 count = 1, bool transpose = false);
+	CommandBuffer& uniformMat4(i32 loc, const f32* v, u32 count = 1, bool transpose = false);
+
+	CommandBuffer& drawArrays(PrimitiveType mode, u32 first, u32 count, u32 instances = 1);
+	CommandBuffer& drawElements(
+		PrimitiveType mode, u32 count,
+		DataType indexType = DataType::TypeUInt,
+		u32 offset = 0, u32 instances = 1, i32 baseVertex = 0
+	);
+
+	CommandBuffer& blit(
+		int sx0, int sy0, int sx1, int sy1,
+		int dx0, int dy0, int dx1, int dy1,
+		ClearBufferMask mask,
+		TextureFilter filter
+	);
+
+	CommandBuffer& dispatch(u32 x, u32 y = 1, u32 z = 1);
+	CommandBuffer& memoryBarrier(u32 barriers);
+
+	// Appends another buffer's packets, keeping their order.
+	CommandBuffer& append(const CommandBuffer& other);
+
+	// Replays every packet in recording order. Must run on the GL thread.
+	void submit() const;
+
+	void reset() { m_data.clear(); m_count = 0; }
+
+	bool empty() const { return m_count == 0; }
+	u32 count() const { return m_count; }
+	size_t sizeBytes() const { return m_data.size(); }
+
+private:
+	struct Header {
+		CommandType type;
+		u32 size; // large uniform arrays exceed 64 KiB
+	};
+
+	struct BindTexturePacket { u32 unit; GLenum target; GLuint id; };
+	struct BindBufferPacket { GLenum target; GLuint id; u32 index, offset, size; };
+	struct BindFramebufferPacket { GLenum target; GLuint id; };
+	struct ViewportPacket { i32 x, y, w, h; };
+	struct ClearColorPacket { f32 r, g, b, a; };
+	struct UniformPacket { i32 loc; UniformType type; u16 transpose; u32 count; };
+	struct DrawArraysPacket { GLenum mode; u32 first, count, instances; };
+	struct DrawElementsPacket { GLenum mode; u32 count; GLenum type; u32 offset, instances; i32 baseVertex; };
+	struct BlitPacket { i32 src[4], dst[4]; u32 mask; GLenum filter; };
+	struct DispatchPacket { u32 x, y, z; };
+
+	// Every packet is a multiple of 4 bytes, so float payloads stay aligned
+	// and replay can hand them to GL in place.
+	static_assert(sizeof(Header) % 4 == 0 && sizeof(UniformPacket) % 4 == 0, "packets must keep 4-byte alignment");
+
+	std::vector<u8> m_data;
+	u32 m_count{ 0 };
+
+	template <typename Packet>
+	inline CommandBuffer& push(CommandType type, const Packet& packet, const void* extra = nullptr, u32 extraSize = 0) {
+		Header header;
+		header.type = type;
+		header.size = u32(sizeof(Packet) + extraSize);
+
+		const size_t at = m_data.size();
+		m_data.resize(at + sizeof(Header) + header.size);
+		std::memcpy(&m_data[at], &header, sizeof(Header));
+		std::memcpy(&m_data[at + sizeof(Header)], &packet, sizeof(Packet));
+		if (extraSize > 0) {
+			std::memcpy(&m_data[at + sizeof(Header) + sizeof(Packet)], extra, extraSize);
+		}
+		m_count++;
+		return *this;
+	}
+
+	CommandBuffer& pushUniform(i32 loc, UniformType type, const f32* v, u32 floats, u32 count = 1, bool transpose = false);
+	static void submitUniform(const u8* data);
+};
+
+#endif // GFXE_COMMAND_H
@@ -0,0 +1,169 @@
+#include "cull.h"
+#include "state.h"
+#include "hash.h"
+
+#include <cmath>
+#include <algorithm>
+
+static const u32 GroupSize = 64;
+
+static const std::string CullSource = R"(#version 430 core
+layout (local_size_x = 64) in;
+
+struct Instance {
+	vec4 sphere;
+	uint count;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+struct Command {
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout (std430, binding = 1) writeonly buffer Commands { Command commands[]; };
+layout (binding = 0, offset = 0) uniform atomic_uint uVisible;
+
+uniform vec4 uPlanes[6];
+uniform uint uInstanceCount;
+
+void main() {
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= uInstanceCount) return;
+
+	Instance inst = instances[i];
+	for (int p = 0; p < 6; p++) {
+		if (dot(uPlanes[p].xyz, inst.sphere.xyz) + uPlanes[p].w < -inst.sphere.w) return;
+	}
+
+	uint slot = atomicCounterIncrement(uVisible);
+	commands[slot] = Command(inst.count, 1u, inst.firstIndex, inst.baseVertex, inst.baseInstance);
+}
+)";
+
+void frustumPlanes(const f32* viewProj, f32* planes) {
+	// Gribb-Hartmann: each plane is row 3 plus or minus one of rows 0..2.
+	for (u32 p = 0; p < 6; p++) {
+		const u32 row = p / 2;
+		const f32 sign = (p % 2 == 0) ? 1.0f : -1.0f;
+		for (u32 c = 0; c < 4; c++) {
+			planes[p * 4 + c] = viewProj[c * 4 + 3] + sign * viewProj[c * 4 + row];
+		}
+		const f32 len = std::sqrt(
+			planes[p * 4 + 0] * planes[p * 4 + 0] +
+			planes[p * 4 + 1] * planes[p * 4 + 1] +
+			planes[p * 4 + 2] * planes[p * 4 + 2]
+		);
+		if (len > 0.0f) {
+			for (u32 c = 0; c < 4; c++) planes[p * 4 + c] /= len;
+		}
+	}
+}
+
+IndirectOutput& IndirectOutput::create(u32 maxCommands) {
+	m_maxCommands = maxCommands;
+	m_commands.create(Buffer::DrawIndirectBuffer)
+		.storage(maxCommands * sizeof(DrawElementsIndirectCommand), Buffer::StorageDynamic);
+	m_counter.create(Buffer::AtomicCounterBuffer)
+		.storage(sizeof(u32), Buffer::StorageDynamic | Buffer::StorageMapRead);
+	return *this;
+}
+
+void IndirectOutput::destroy() {
+	m_commands.destroy();
+	m_counter.destroy();
+	m_maxCommands = m_count = 0;
+}
+
+IndirectOutput& IndirectOutput::begin(u32 count, u32 commandBinding, u32 counterBinding) {
+	m_count = std::min(count, m_maxCommands);
+
+	const u32 zero = 0;
+	m_counter.updateRange(0, sizeof(u32), &zero);
+	if (!GLAD_GL_VERSION_4_6) {
+		m_commands.clear();
+	}
+
+	StateCache::get().bindBufferBase(GL_SHADER_STORAGE_BUFFER, commandBinding, m_commands.id());
+	m_counter.bindBase(counterBinding);
+	return *this;
+}
+
+IndirectOutput& IndirectOutput::dispatch(u32 groupSize) {
+	glDispatchCompute((m_count + groupSize - 1) / groupSize, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+	return *this;
+}
+
+IndirectOutput& IndirectOutput::draw(Shader& shader, VertexArray& vao, PrimitiveType mode, DataType indexType) {
+	if (m_count == 0) {
+		return *this;
+	}
+
+	shader.bind();
+	vao.bind();
+	m_commands.bind();
+
+	if (GLAD_GL_VERSION_4_6) {
+		StateCache::get().bindBuffer(GL_PARAMETER_BUFFER, m_counter.id());
+		glMultiDrawElementsIndirectCount(mode, indexType, nullptr, 0, m_count, 0);
+	} else {
+		glMultiDrawElementsIndirect(mode, indexType, nullptr, m_count, 0);
+	}
+	return *this;
+}
+
+u32 IndirectOutput::visible() {
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	u32* count = m_counter.mapRange<u32>(0, sizeof(u32), GL_MAP_READ_BIT);
+	const u32 n = count ? *count : 0;
+	m_counter.unmap();
+	return n;
+}
+
+CullPass& CullPass::create(u32 maxInstances) {
+	m_shader.create()
+		.add(CullSource, Shader::ComputeShader)
+		.link()
+		.wait();
+	m_planes = m_shader.findUniform("uPlanes"_h);
+	m_instanceCount = m_shader.findUniform("uInstanceCount"_h);
+	m_output.create(maxInstances);
+	return *this;
+}
+
+void CullPass::destroy() {
+	m_shader.destroy();
+	m_output.destroy();
+}
+
+CullPass& CullPass::dispatch(Buffer& instances, u32 instanceCount, const f32* viewProj) {
+	f32 planes[24];
+	frustumPlanes(viewProj, planes);
+
+	m_output.begin(instanceCount, CommandBinding, CounterBinding);
+
+	m_shader.set(m_planes, planes, 24)
+		.set(m_instanceCount, m_output.count())
+		.bind();
+
+	StateCache::get().bindBufferBase(GL_SHADER_STORAGE_BUFFER, InstanceBinding, instances.id());
+	m_output.dispatch(GroupSize);
+
+	return *this;
+}
+
+CullPass& CullPass::draw(Shader& shader, VertexArray& vao, PrimitiveType mode, DataType indexType) {
+	m_output.draw(shader, vao, mode, indexType);
+	return *this;
+}
+
+u32 CullPass::visible() {
+	return m_output.visible();
+}
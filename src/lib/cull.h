@@ -0,0 +1,93 @@
+#ifndef GFXE_CULL_H
+#define GFXE_CULL_H
+
+#include "batch.h"
+
+// Extracts the six normalized frustum planes (xyz = normal, w = distance)
+// from a column-major view-projection matrix into planes[24].
+void frustumPlanes(const f32* viewProj, f32* planes);
+
+// The output side of a GPU culling pass: a command buffer that a compute
+// shader appends to, the atomic counter it bumps, and the indirect draw that
+// consumes both.
+class IndirectOutput {
+public:
+	IndirectOutput() = default;
+	~IndirectOutput() = default;
+
+	IndirectOutput& create(u32 maxCommands);
+	void destroy();
+
+	// Resets the counter, and the commands without GL 4.6, then binds both
+	// for a dispatch over `count` inputs (clamped to maxCommands).
+	IndirectOutput& begin(u32 count, u32 commandBinding, u32 counterBinding);
+
+	// Runs the bound compute program over the inputs and makes its writes
+	// visible to indirect draws.
+	IndirectOutput& dispatch(u32 groupSize);
+
+	// Draws the surviving commands. Without GL 4.6 the culled slots are left
+	// zeroed and drawn as empty commands instead.
+	IndirectOutput& draw(Shader& shader, VertexArray& vao, PrimitiveType mode, DataType indexType);
+
+	// Reads the appended count back; stalls until the dispatch completes.
+	u32 visible();
+
+	Buffer& commands() { return m_commands; }
+	Buffer& counter() { return m_counter; }
+	u32 maxCommands() const { return m_maxCommands; }
+	u32 count() const { return m_count; }
+
+private:
+	Buffer m_commands, m_counter;
+	u32 m_maxCommands{ 0 }, m_count{ 0 };
+};
+
+// Frustum culling on the GPU. A compute pass tests one bounding sphere per
+// instance and appends a draw command for every visible one, bumping an
+// atomic counter that draw() then feeds to glMultiDrawElementsIndirectCount.
+class CullPass {
+public:
+	// std430 layout of one entry in the instance buffer.
+	struct Instance {
+		f32 center[3];
+		f32 radius;
+		u32 count;
+		u32 firstIndex;
+		i32 baseVertex;
+		u32 baseInstance;
+	};
+
+	enum Binding {
+		InstanceBinding = 0,
+		CommandBinding = 1,
+		CounterBinding = 0
+	};
+
+	CullPass() = default;
+	~CullPass() = default;
+
+	CullPass& create(u32 maxInstances);
+	void destroy();
+
+	// viewProj is a column-major 4x4 matrix. instances must hold at least
+	// instanceCount entries laid out as Instance.
+	CullPass& dispatch(Buffer& instances, u32 instanceCount, const f32* viewProj);
+
+	// See IndirectOutput::draw.
+	CullPass& draw(Shader& shader, VertexArray& vao, PrimitiveType mode = PrimitiveType::Triangles, DataType indexType = DataType::TypeUInt);
+
+	// Reads the visible count back; stalls until the dispatch completes.
+	u32 visible();
+
+	Buffer& commands() { return m_output.commands(); }
+	Buffer& counter() { return m_output.counter(); }
+	u32 maxInstances() const { return m_output.maxCommands(); }
+
+private:
+	Shader m_shader;
+	IndirectOutput m_output;
+	u32 m_planes{ Shader::InvalidIndex }, m_instanceCount{ Shader::InvalidIndex };
+};
+
+#endif // GFXE_CULL_H
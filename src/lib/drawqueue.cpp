@@ -0,0 +1,180 @@
+#include "drawqueue.h"
+
+#include <algorithm>
+
+static GLuint idOf(const FrameBuffer* fbo) { return fbo ? fbo->id() : 0; }
+static GLuint idOf(const Shader* shader) { return shader ? shader->activeId() : 0; }
+static GLuint idOf(const VertexArray* vao) { return vao ? vao->id() : 0; }
+static GLuint idOf(const Texture* tex) { return tex ? tex->id() : 0; }
+
+static u32 textureSetHash(const DrawQueue::Draw& draw) {
+	u32 h = 2166136261u;
+	for (u32 i = 0; i < DrawQueue::MaxTextures; i++) {
+		h = (h ^ idOf(draw.textures[i])) * 16777619u;
+	}
+	return h;
+}
+
+u64 DrawQueue::makeKey(const Draw& draw) {
+	const f32 depth = std::min(std::max(draw.depth, 0.0f), 1.0f);
+
+	u64 key = 0;
+	key |= u64(idOf(draw.target) & 0xFF) << 56;
+	key |= u64(idOf(draw.shader) & 0xFFF) << 44;
+	key |= u64(textureSetHash(draw) & 0xFFF) << 32;
+	key |= u64(idOf(draw.vao) & 0xFFF) << 20;
+	key |= u64(depth * f32(0xFFFFF)) & 0xFFFFF;
+	return key;
+}
+
+DrawQueue& DrawQueue::viewport(u32 width, u32 height) {
+	m_width = width;
+	m_height = height;
+	return *this;
+}
+
+DrawQueue& DrawQueue::add(const Draw& draw) {
+	m_draws.push_back(draw);
+	m_keys.push_back(makeKey(draw));
+	return *this;
+}
+
+DrawQueue& DrawQueue::clear() {
+	m_draws.clear();
+	m_keys.clear();
+	return *this;
+}
+
+void DrawQueue::sort() {
+	const u32 n = u32(m_keys.size());
+	m_order.resize(n);
+	m_orderTemp.resize(n);
+	m_keysSorted = m_keys;
+	m_keysTemp.resize(n);
+	for (u32 i = 0; i < n; i++) {
+		m_order[i] = i;
+	}
+
+	// LSD radix sort, 8 bits per pass. Passes where every key has the same
+	// digit are skipped, which is common for the high framebuffer bits.
+	std::vector<u64>* keysIn = &m_keysSorted;
+	std::vector<u64>* keysOut = &m_keysTemp;
+	std::vector<u32>* orderIn = &m_order;
+	std::vector<u32>* orderOut = &m_orderTemp;
+
+	for (u32 shift = 0; shift < 64; shift += 8) {
+		u32 histogram[256] = {};
+		for (u32 i = 0; i < n; i++) {
+			histogram[((*keysIn)[i] >> shift) & 0xFF]++;
+		}
+
+		const u32 firstDigit = ((*keysIn)[0] >> shift) & 0xFF;
+		if (histogram[firstDigit] == n) {
+			continue;
+		}
+
+		u32 sum = 0;
+		for (u32 d = 0; d < 256; d++) {
+			const u32 c = histogram[d];
+			histogram[d] = sum;
+			sum += c;
+		}
+
+		for (u32 i = 0; i < n; i++) {
+			const u32 d = ((*keysIn)[i] >> shift) & 0xFF;
+			const u32 at = histogram[d]++;
+			(*keysOut)[at] = (*keysIn)[i];
+			(*orderOut)[at] = (*orderIn)[i];
+		}
+
+		std::swap(keysIn, keysOut);
+		std::swap(orderIn, orderOut);
+	}
+
+	if (orderIn != &m_order) {
+		m_order.swap(m_orderTemp);
+	}
+	if (keysIn != &m_keysSorted) {
+		m_keysSorted.swap(m_keysTemp);
+	}
+}
+
+u32 DrawQueue::countSwitches(const Draw& a, const Draw& b) {
+	u32 switches = 0;
+	if (idOf(a.target) != idOf(b.target)) switches++;
+	if (idOf(a.shader) != idOf(b.shader)) switches++;
+	if (idOf(a.vao) != idOf(b.vao)) switches++;
+	for (u32 i = 0; i < MaxTextures; i++) {
+		if (idOf(a.textures[i]) != idOf(b.textures[i])) switches++;
+	}
+	return switches;
+}
+
+DrawQueue& DrawQueue::record(CommandBuffer& cmd) {
+	m_stats = Stats{};
+	m_stats.draws = u32(m_draws.size());
+	if (m_draws.empty()) {
+		return *this;
+	}
+
+	for (u32 i = 1; i < m_draws.size(); i++) {
+		m_stats.switchesUnsorted += countSwitches(m_draws[i - 1], m_draws[i]);
+	}
+
+	sort();
+
+	const Draw* prev = nullptr;
+	for (u32 i : m_order) {
+		const Draw& d = m_draws[i];
+
+		if (!prev || idOf(prev->target) != idOf(d.target)) {
+			if (d.target) {
+				cmd.bind(*d.target, FrameBufferTarget::DrawFrameBuffer);
+			} else {
+				cmd.bindDefaultFramebuffer(FrameBufferTarget::DrawFrameBuffer);
+				if (m_width > 0 && m_height > 0) {
+					cmd.viewport(0, 0, m_width, m_height);
+				}
+			}
+		}
+		if (d.shader && (!prev || idOf(prev->shader) != idOf(d.shader))) {
+			cmd.bind(*d.shader);
+		}
+		if (d.vao && (!prev || idOf(prev->vao) != idOf(d.vao))) {
+			cmd.bind(*d.vao);
+		}
+		for (u32 t = 0; t < MaxTextures; t++) {
+			if (d.textures[t] && (!prev || idOf(prev->textures[t]) != idOf(d.textures[t]))) {
+				cmd.bind(*d.textures[t], t);
+			}
+		}
+		if (d.uniformBuffer) {
+			cmd.bindRange(GL_UNIFORM_BUFFER, d.uniformBuffer, d.uniformBinding, d.uniformOffset, d.uniformSize);
+		}
+
+		if (prev) {
+			m_stats.switchesSorted += countSwitches(*prev, d);
+		}
+
+		if (d.indexed) {
+			const u32 indexSize = d.indexType == DataType::TypeUByte ? 1 : d.indexType == DataType::TypeUShort ? 2 : 4;
+			cmd.drawElements(d.mode, d.count, d.indexType, d.first * indexSize, d.instances, d.baseVertex);
+		} else {
+			cmd.drawArrays(d.mode, d.first, d.count, d.instances);
+		}
+		prev = &d;
+	}
+
+	return *this;
+}
+
+DrawQueue& DrawQueue::submit() {
+	for (auto&& draw : m_draws) {
+		if (draw.shader) draw.shader->flush();
+	}
+
+	m_commands.reset();
+	record(m_commands);
+	m_commands.submit();
+	return *this;
+}
@@ -0,0 +1,78 @@
+#ifndef GFXE_DRAWQUEUE_H
+#define GFXE_DRAWQUEUE_H
+
+#include <vector>
+
+#include "command.h"
+
+// Collects draws in any order, sorts them by a packed 64-bit state key and
+// records them with only the binds that actually change between draws.
+//
+// Key layout, most significant first:
+//   framebuffer (8) | program (12) | texture set (12) | vertex array (12) | depth (20)
+class DrawQueue {
+public:
+	static constexpr u32 MaxTextures = 4;
+
+	struct Draw {
+		const FrameBuffer* target{ nullptr };
+		const Shader* shader{ nullptr };
+		const VertexArray* vao{ nullptr };
+		const Texture* textures[MaxTextures]{};
+
+		// Optional per-draw uniform block, e.g. a BufferArena slice.
+		GLuint uniformBuffer{ 0 };
+		u32 uniformBinding{ 0 }, uniformOffset{ 0 }, uniformSize{ 0 };
+
+		PrimitiveType mode{ PrimitiveType::Triangles };
+		bool indexed{ false };
+		DataType indexType{ DataType::TypeUInt };
+		u32 first{ 0 }, count{ 0 }, instances{ 1 };
+		i32 baseVertex{ 0 };
+
+		// Normalized view depth in [0, 1], used to sort front to back.
+		f32 depth{ 0.0f };
+	};
+
+	struct Stats {
+		u32 draws{ 0 };
+		u32 switchesUnsorted{ 0 };
+		u32 switchesSorted{ 0 };
+	};
+
+	DrawQueue() = default;
+	~DrawQueue() = default;
+
+	// Viewport for draws that target the default framebuffer.
+	DrawQueue& viewport(u32 width, u32 height);
+
+	DrawQueue& add(const Draw& draw);
+
+	// Sorts the pending draws and records them into cmd.
+	DrawQueue& record(CommandBuffer& cmd);
+
+	// record() into an internal buffer and submit it right away.
+	DrawQueue& submit();
+
+	DrawQueue& clear();
+
+	const Stats& stats() const { return m_stats; }
+	u32 size() const { return u32(m_draws.size()); }
+
+	static u64 makeKey(const Draw& draw);
+
+private:
+	std::vector<Draw> m_draws;
+	std::vector<u64> m_keys, m_keysSorted, m_keysTemp;
+	std::vector<u32> m_order, m_orderTemp;
+
+	CommandBuffer m_commands;
+	u32 m_width{ 0 }, m_height{ 0 };
+
+	Stats m_stats;
+
+	void sort();
+	static u32 countSwitches(const Draw& a, const Draw& b);
+};
+
+#endif // GFXE_DRAWQUEUE_H
@@ -1,9 +1,11 @@
 #include "framebuffer.h"
+#include "state.h"
 
 #include <iostream>
 
 void FrameBuffer::destroy() {
 	if (m_id) {
+		StateCache::get().forgetFramebuffer(m_id);
 		glDeleteFramebuffers(1, &m_id);
 		m_id = 0;
 	}
@@ -18,7 +20,11 @@ FrameBuffer& FrameBuffer::create(u32 width, u32 height, u32 depth) {
 	m_height = height;
 	m_depth = depth;
 
-	glGenFramebuffers(1, &m_id);
+	if (Caps::directStateAccess()) {
+		glCreateFramebuffers(1, &m_id);
+	} else {
+		glGenFramebuffers(1, &m_id);
+	}
 
 	return *this;
 }
@@ -28,12 +34,14 @@ FrameBuffer& FrameBuffer::color(
 	bool floatingPoint,
 	u32 depthSize, u32 mip, u32 layer
 ) {
-	glBindFramebuffer(GL_FRAMEBUFFER, m_id);
+	const bool dsa = Caps::directStateAccess();
+	if (!dsa) StateCache::get().bindFramebuffer(GL_FRAMEBUFFER, m_id);
 
 	DataType dt = floatingPoint ? DataType::TypeFloat : DataType::TypeUByte;
 	Texture tex{};
-	tex.create(type, format, m_width, m_height, m_depth, floatingPoint, depthSize).bind()
-		.wrapMode(TextureWrap::ClampToEdge, TextureWrap::ClampToEdge)
+	tex.create(type, format, m_width, m_height, m_depth, floatingPoint, depthSize);
+	if (!dsa) tex.bind();
+	tex.wrapMode(TextureWrap::ClampToEdge, TextureWrap::ClampToEdge)
 		.filter(TextureFilter::LinearMipMapLinear, TextureFilter::Linear);
 	if (type == TextureType::CubeMap) {
 		tex.updateCube(nullptr, CubeMapSide::NegativeX, dt);
@@ -62,6 +70,25 @@ FrameBuffer& FrameBuffer::color(
 	}
 
 	GLenum atc = GL_COLOR_ATTACHMENT0 + att;
+	if (dsa) {
+		switch (type) {
+			case TextureType::Texture3D:
+			case TextureType::Texture2DArray:
+				glNamedFramebufferTextureLayer(m_id, atc, tex.id(), mip, layer);
+				break;
+			default:
+				glNamedFramebufferTexture(m_id, atc, tex.id(), mip);
+				break;
+		}
+
+		StateCache::get().drawBuffers(m_id, db.size(), db.data());
+
+		if (glCheckNamedFramebufferStatus(m_id, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+			m_colorAttachments.push_back(tex);
+		}
+		return *this;
+	}
+
 	switch (type) {
 		case TextureType::Texture1D:
 			glFramebufferTexture1D(GL_FRAMEBUFFER, atc, type, tex.id(), mip);
@@ -80,14 +107,14 @@ FrameBuffer& FrameBuffer::color(
 			break;
 	}
 
-	glDrawBuffers(db.size(), db.data());
+	StateCache::get().drawBuffers(m_id, db.size(), db.data());
 
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
 		return *this;
 	}
 
 	m_colorAttachments.push_back(tex);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	StateCache::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	return *this;
 }
@@ -97,10 +124,21 @@ FrameBuffer& FrameBuffer::depth(u32 depthSize) {
 		return *this;
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, m_id);
-
 	Texture tex{};
-	tex.create(TextureType::Texture2D, Format::Depth, m_width, m_height, 1, true, depthSize).bind()
+	tex.create(TextureType::Texture2D, Format::Depth, m_width, m_height, 1, true, depthSize);
+
+	if (Caps::directStateAccess()) {
+		tex.wrapMode(TextureWrap::ClampToEdge, TextureWrap::ClampToEdge)
+			.filter(TextureFilter::Nearest, TextureFilter::Nearest)
+			.storage(1);
+		glNamedFramebufferTexture(m_id, GL_DEPTH_ATTACHMENT, tex.id(), 0);
+		m_depthAttachment = tex;
+		return *this;
+	}
+
+	StateCache::get().bindFramebuffer(GL_FRAMEBUFFER, m_id);
+
+	tex.bind()
 		.wrapMode(TextureWrap::ClampToEdge, TextureWrap::ClampToEdge)
 		.filter(TextureFilter::Nearest, TextureFilter::Nearest);
 
@@ -113,7 +151,7 @@ FrameBuffer& FrameBuffer::depth(u32 depthSize) {
 	);
 
 	m_depthAttachment = tex;
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	StateCache::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	return *this;
 }
@@ -123,10 +161,21 @@ FrameBuffer& FrameBuffer::stencil() {
 		return *this;
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, m_id);
-
 	Texture tex{};
-	tex.create(TextureType::Texture2D, Format::R, m_width, m_height, 1, true).bind()
+	tex.create(TextureType::Texture2D, Format::R, m_width, m_height, 1, true);
+
+	if (Caps::directStateAccess()) {
+		tex.wrapMode(TextureWrap::ClampToEdge, TextureWrap::ClampToEdge)
+			.filter(TextureFilter::Nearest, TextureFilter::Nearest)
+			.storage(1);
+		glNamedFramebufferTexture(m_id, GL_STENCIL_ATTACHMENT, tex.id(), 0);
+		m_stencilAttachment = tex;
+		return *this;
+	}
+
+	StateCache::get().bindFramebuffer(GL_FRAMEBUFFER, m_id);
+
+	tex.bind()
 		.wrapMode(TextureWrap::ClampToEdge, TextureWrap::ClampToEdge)
 		.filter(TextureFilter::Nearest, TextureFilter::Nearest);
 
@@ -139,7 +188,7 @@ FrameBuffer& FrameBuffer::stencil() {
 	);
 
 	m_stencilAttachment = tex;
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	StateCache::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	return *this;
 }
@@ -156,9 +205,21 @@ FrameBuffer& FrameBuffer::renderBuffer(
 
 	m_renderBufferStorage = storage;
 	GLenum ifmt = getInternalFormat(storage, floatingPoint, depthSize);
+
+	if (Caps::directStateAccess()) {
+		glCreateRenderbuffers(1, &m_rboID);
+		glNamedRenderbufferStorage(m_rboID, ifmt, m_width, m_height);
+		glNamedFramebufferRenderbuffer(m_id, attachment, GL_RENDERBUFFER, m_rboID);
+		if (glCheckNamedFramebufferStatus(m_id, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			glDeleteRenderbuffers(1, &m_rboID);
+			m_rboID = 0;
+		}
+		return *this;
+	}
+
 	glGenRenderbuffers(1, &m_rboID);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, m_id);
+	StateCache::get().bindFramebuffer(GL_FRAMEBUFFER, m_id);
 	glBindRenderbuffer(GL_RENDERBUFFER, m_rboID);
 	glRenderbufferStorage(GL_RENDERBUFFER, ifmt, m_width, m_height);
 	glFramebufferRenderbuffer(
@@ -173,17 +234,18 @@ FrameBuffer& FrameBuffer::renderBuffer(
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
 		glDeleteRenderbuffers(1, &m_rboID);
 		m_rboID = 0;
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		StateCache::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 		return *this;
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	StateCache::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	return *this;
 }
 
 void FrameBuffer::drawBuffer(u32 index) {
-	glDrawBuffer(GL_COLOR_ATTACHMENT0 + index);
+	GLenum buf = GL_COLOR_ATTACHMENT0 + index;
+	StateCache::get().drawBuffers(m_id, 1, &buf);
 }
 
 void FrameBuffer::resetDrawBuffers() {
@@ -192,7 +254,7 @@ void FrameBuffer::resetDrawBuffers() {
 	for (int i = 0; i < att; i++) {
 		db.push_back(GL_COLOR_ATTACHMENT0 + i);
 	}
-	glDrawBuffers(db.size(), db.data());
+	StateCache::get().drawBuffers(m_id, db.size(), db.data());
 }
 
 void FrameBuffer::blit(
@@ -205,10 +267,13 @@ void FrameBuffer::blit(
 }
 
 FrameBuffer& FrameBuffer::bind(FrameBufferTarget target, Attachment readBuffer) {
+	StateCache& cache = StateCache::get();
 	m_bound = target;
-	glGetIntegerv(GL_VIEWPORT, m_viewport);
-	glBindFramebuffer(target, m_id);
-	glViewport(0, 0, m_width, m_height);
+	if (!cache.getViewport(m_viewport)) {
+		glGetIntegerv(GL_VIEWPORT, m_viewport);
+	}
+	cache.bindFramebuffer(target, m_id);
+	cache.viewport(0, 0, m_width, m_height);
 	if (target == FrameBufferTarget::ReadFrameBuffer) {
 		glReadBuffer(readBuffer);
 	}
@@ -216,9 +281,9 @@ FrameBuffer& FrameBuffer::bind(FrameBufferTarget target, Attachment readBuffer)
 }
 
 FrameBuffer& FrameBuffer::unbind(bool resetViewport) {
-	glBindFramebuffer(m_bound, 0);
+	StateCache::get().bindFramebuffer(m_bound, 0);
 	if (resetViewport) {
-		glViewport(
+		StateCache::get().viewport(
 			m_viewport[0],
 			m_viewport[1],
 			m_viewport[2],
@@ -74,6 +74,9 @@ public:
 	u32 height() const { return m_height; }
 	u32 depth() const { return m_depth; }
 
+	FrameBuffer& markUsed(GpuTimeline& timeline) { m_lastUse = timeline.pending(); return *this; }
+	u64 lastUse() const { return m_lastUse; }
+
 private:
 	struct SavedColorAttachment {
 		Format format;
@@ -87,6 +90,7 @@ private:
 	i32 m_viewport[4];
 
 	FrameBufferTarget m_bound;
+	u64 m_lastUse{ 0 };
 
 	Format m_renderBufferStorage;
 
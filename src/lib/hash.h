@@ -0,0 +1,40 @@
+#ifndef GFXE_HASH_H
+#define GFXE_HASH_H
+
+#include <string>
+
+#include "integer.h"
+
+// 64-bit FNV-1a. The string form is constexpr so names can be hashed at
+// compile time and compared against hashes computed at runtime.
+constexpr u64 FnvOffset = 14695981039346656037ull;
+constexpr u64 FnvPrime = 1099511628211ull;
+
+constexpr u64 hashString(const char* str, u64 hash = FnvOffset) {
+	while (*str) {
+		hash = (hash ^ u64(u8(*str++))) * FnvPrime;
+	}
+	return hash;
+}
+
+// "name"_h, for compile-time uniform and block lookups.
+constexpr u64 operator""_h(const char* str, size_t) {
+	return hashString(str);
+}
+
+inline u64 hashString(const std::string& str, u64 hash = FnvOffset) {
+	for (char c : str) {
+		hash = (hash ^ u64(u8(c))) * FnvPrime;
+	}
+	return hash;
+}
+
+inline u64 hashBytes(const void* data, size_t size, u64 hash = FnvOffset) {
+	const u8* bytes = static_cast<const u8*>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ u64(bytes[i])) * FnvPrime;
+	}
+	return hash;
+}
+
+#endif // GFXE_HASH_H
@@ -0,0 +1,412 @@
+#include "heap.h"
+#include "state.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static u32 bitScanForward(u32 v) {
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward(&i, v);
+	return u32(i);
+#else
+	return u32(__builtin_ctz(v));
+#endif
+}
+
+static u32 bitScanReverse(u32 v) {
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanReverse(&i, v);
+	return u32(i);
+#else
+	return u32(31 - __builtin_clz(v));
+#endif
+}
+
+void TlsfAllocator::create(u32 size, u32 granularity) {
+	m_granularity = std::max(granularity, 1u);
+	m_capacity = (size / m_granularity) * m_granularity;
+	m_used = 0;
+	m_freeBlocks = 0;
+
+	m_blocks.clear();
+	m_unusedBlocks.clear();
+	m_flBitmap = 0;
+	m_slBitmap.fill(0);
+	for (auto&& row : m_heads) {
+		row.fill(InvalidBlock);
+	}
+
+	if (m_capacity == 0) {
+		return;
+	}
+
+	u32 b = newBlock();
+	m_blocks[b].offset = 0;
+	m_blocks[b].size = m_capacity;
+	insertFree(b);
+}
+
+u32 TlsfAllocator::newBlock() {
+	u32 b;
+	if (!m_unusedBlocks.empty()) {
+		b = m_unusedBlocks.back();
+		m_unusedBlocks.pop_back();
+	} else {
+		b = u32(m_blocks.size());
+		m_blocks.emplace_back();
+	}
+	m_blocks[b] = Block{ 0, 0, InvalidBlock, InvalidBlock, InvalidBlock, InvalidBlock, false };
+	return b;
+}
+
+void TlsfAllocator::mapping(u32 size, u32& fl, u32& sl) const {
+	const u32 units = size / m_granularity;
+	if (units < SLCount) {
+		fl = 0;
+		sl = units;
+	} else {
+		const u32 m = bitScanReverse(units);
+		fl = m - SLLog2 + 1;
+		sl = (units >> (m - SLLog2)) - SLCount;
+	}
+}
+
+void TlsfAllocator::insertFree(u32 block) {
+	Block& b = m_blocks[block];
+	u32 fl, sl;
+	mapping(b.size, fl, sl);
+
+	b.free = true;
+	b.prevFree = InvalidBlock;
+	b.nextFree = m_heads[fl][sl];
+	if (b.nextFree != InvalidBlock) {
+		m_blocks[b.nextFree].prevFree = block;
+	}
+	m_heads[fl][sl] = block;
+
+	m_flBitmap |= 1u << fl;
+	m_slBitmap[fl] |= 1u << sl;
+	m_freeBlocks++;
+}
+
+void TlsfAllocator::removeFree(u32 block) {
+	Block& b = m_blocks[block];
+	u32 fl, sl;
+	mapping(b.size, fl, sl);
+
+	if (b.prevFree != InvalidBlock) {
+		m_blocks[b.prevFree].nextFree = b.nextFree;
+	} else {
+		m_heads[fl][sl] = b.nextFree;
+	}
+	if (b.nextFree != InvalidBlock) {
+		m_blocks[b.nextFree].prevFree = b.prevFree;
+	}
+
+	if (m_heads[fl][sl] == InvalidBlock) {
+		m_slBitmap[fl] &= ~(1u << sl);
+		if (m_slBitmap[fl] == 0) {
+			m_flBitmap &= ~(1u << fl);
+		}
+	}
+
+	b.free = false;
+	b.prevFree = b.nextFree = InvalidBlock;
+	m_freeBlocks--;
+}
+
+u32 TlsfAllocator::allocate(u32 size) {
+	if (size == 0 || size > m_capacity - m_used) {
+		return InvalidBlock;
+	}
+
+	size = ((size + m_granularity - 1) / m_granularity) * m_granularity;
+
+	// Round up to the next class so any block found there is large enough.
+	u32 units = size / m_granularity;
+	if (units >= SLCount) {
+		units += (1u << (bitScanReverse(units) - SLLog2)) - 1;
+	}
+
+	u32 fl, sl;
+	mapping(units * m_granularity, fl, sl);
+	if (fl >= FLCount) {
+		return InvalidBlock;
+	}
+
+	u32 slMap = m_slBitmap[fl] & (~0u << sl);
+	if (slMap == 0) {
+		const u32 flMap = fl + 1 < FLCount ? m_flBitmap & (~0u << (fl + 1)) : 0;
+		if (flMap == 0) {
+			return InvalidBlock;
+		}
+		fl = bitScanForward(flMap);
+		slMap = m_slBitmap[fl];
+	}
+	sl = bitScanForward(slMap);
+
+	const u32 block = m_heads[fl][sl];
+	removeFree(block);
+
+	if (m_blocks[block].size - size >= m_granularity) {
+		const u32 rest = newBlock();
+		Block& b = m_blocks[block];
+		Block& r = m_blocks[rest];
+		r.offset = b.offset + size;
+		r.size = b.size - size;
+		r.prevPhys = block;
+		r.nextPhys = b.nextPhys;
+		if (r.nextPhys != InvalidBlock) {
+			m_blocks[r.nextPhys].prevPhys = rest;
+		}
+		b.nextPhys = rest;
+		b.size = size;
+		insertFree(rest);
+	}
+
+	m_used += m_blocks[block].size;
+	return block;
+}
+
+void TlsfAllocator::free(u32 block) {
+	if (block == InvalidBlock || m_blocks[block].free) {
+		return;
+	}
+
+	m_used -= m_blocks[block].size;
+
+	const u32 prev = m_blocks[block].prevPhys;
+	if (prev != InvalidBlock && m_blocks[prev].free) {
+		removeFree(prev);
+		Block& p = m_blocks[prev];
+		p.size += m_blocks[block].size;
+		p.nextPhys = m_blocks[block].nextPhys;
+		if (p.nextPhys != InvalidBlock) {
+			m_blocks[p.nextPhys].prevPhys = prev;
+		}
+		m_unusedBlocks.push_back(block);
+		block = prev;
+	}
+
+	const u32 next = m_blocks[block].nextPhys;
+	if (next != InvalidBlock && m_blocks[next].free) {
+		removeFree(next);
+		Block& b = m_blocks[block];
+		b.size += m_blocks[next].size;
+		b.nextPhys = m_blocks[next].nextPhys;
+		if (b.nextPhys != InvalidBlock) {
+			m_blocks[b.nextPhys].prevPhys = block;
+		}
+		m_unusedBlocks.push_back(next);
+	}
+
+	insertFree(block);
+}
+
+u32 TlsfAllocator::largestFree() const {
+	if (m_flBitmap == 0) {
+		return 0;
+	}
+	const u32 fl = bitScanReverse(m_flBitmap);
+	const u32 sl = bitScanReverse(m_slBitmap[fl]);
+
+	u32 largest = 0;
+	for (u32 b = m_heads[fl][sl]; b != InvalidBlock; b = m_blocks[b].nextFree) {
+		largest = std::max(largest, m_blocks[b].size);
+	}
+	return largest;
+}
+
+GpuHeap& GpuHeap::create(Buffer::BufferType type, u32 pageSize, u32 granularity) {
+	m_type = type;
+	m_pageSize = pageSize;
+	m_granularity = granularity;
+	return *this;
+}
+
+void GpuHeap::destroy() {
+	for (auto&& page : m_pages) {
+		page.buffer.destroy();
+	}
+	m_pages.clear();
+	m_ranges.clear();
+	m_unusedHandles.clear();
+}
+
+u32 GpuHeap::addPage(u32 size) {
+	Page page;
+	page.buffer.create(m_type).storage(size, Buffer::StorageDynamic);
+	page.allocator.create(size, m_granularity);
+	m_pages.push_back(page);
+	return u32(m_pages.size() - 1);
+}
+
+bool GpuHeap::place(Page& page, u32 size, u32 alignment, u32& block, u32& offset) {
+	const u32 padding = (m_granularity % alignment == 0) ? 0 : alignment - 1;
+	block = page.allocator.allocate(size + padding);
+	if (block == TlsfAllocator::InvalidBlock) {
+		return false;
+	}
+	const u32 start = page.allocator.offset(block);
+	offset = ((start + alignment - 1) / alignment) * alignment;
+	return true;
+}
+
+GpuHeap::Handle GpuHeap::allocate(u32 size, u32 alignment) {
+	if (size == 0) {
+		return InvalidHandle;
+	}
+	if (alignment == 0) {
+		alignment = m_granularity;
+	}
+
+	Range range{};
+	range.size = size;
+	range.alignment = alignment;
+	range.live = true;
+
+	bool placed = false;
+	for (u32 i = 0; i < m_pages.size() && !placed; i++) {
+		if (place(m_pages[i], size, alignment, range.block, range.offset)) {
+			range.page = i;
+			placed = true;
+		}
+	}
+
+	if (!placed) {
+		range.page = addPage(std::max(m_pageSize, size + alignment));
+		if (!place(m_pages[range.page], size, alignment, range.block, range.offset)) {
+			return InvalidHandle;
+		}
+	}
+
+	Handle handle;
+	if (!m_unusedHandles.empty()) {
+		handle = m_unusedHandles.back();
+		m_unusedHandles.pop_back();
+		m_ranges[handle] = range;
+	} else {
+		handle = Handle(m_ranges.size());
+		m_ranges.push_back(range);
+	}
+	return handle;
+}
+
+void GpuHeap::free(Handle handle) {
+	if (handle >= m_ranges.size() || !m_ranges[handle].live) {
+		return;
+	}
+	Range& range = m_ranges[handle];
+	m_pages[range.page].allocator.free(range.block);
+	range.live = false;
+	m_unusedHandles.push_back(handle);
+}
+
+std::vector<GpuHeap::Relocation> GpuHeap::defragment(f32 threshold) {
+	std::vector<Relocation> relocations;
+
+	for (u32 p = 0; p < m_pages.size(); p++) {
+		Page& page = m_pages[p];
+		const u32 free = page.allocator.capacity() - page.allocator.used();
+		if (free == 0) continue;
+
+		const f32 frag = 1.0f - f32(page.allocator.largestFree()) / f32(free);
+		if (frag <= threshold) continue;
+
+		std::vector<Handle> live;
+		for (Handle h = 0; h < m_ranges.size(); h++) {
+			if (m_ranges[h].live && m_ranges[h].page == p) {
+				live.push_back(h);
+			}
+		}
+		std::sort(live.begin(), live.end(), [&](Handle a, Handle b) {
+			return m_ranges[a].offset < m_ranges[b].offset;
+		});
+
+		Page fresh;
+		fresh.buffer.create(m_type).storage(page.allocator.capacity(), Buffer::StorageDynamic);
+		fresh.allocator.create(page.allocator.capacity(), m_granularity);
+
+		// Place everything before touching any range, so a page that can't be
+		// repacked is left exactly as it was.
+		std::vector<Relocation> moved;
+		std::vector<u32> blocks;
+		bool placed = true;
+		for (Handle h : live) {
+			const Range& range = m_ranges[h];
+
+			Relocation rel;
+			rel.handle = h;
+			rel.oldPage = rel.newPage = p;
+			rel.oldOffset = range.offset;
+
+			u32 block;
+			if (!place(fresh, range.size, range.alignment, block, rel.newOffset)) {
+				placed = false;
+				break;
+			}
+			moved.push_back(rel);
+			blocks.push_back(block);
+		}
+		if (!placed) {
+			fresh.buffer.destroy();
+			continue;
+		}
+
+		const bool dsa = Caps::directStateAccess();
+		if (!dsa) {
+			StateCache::get().bindBuffer(GL_COPY_READ_BUFFER, page.buffer.id());
+			StateCache::get().bindBuffer(GL_COPY_WRITE_BUFFER, fresh.buffer.id());
+		}
+
+		for (u32 i = 0; i < moved.size(); i++) {
+			const Relocation& rel = moved[i];
+			Range& range = m_ranges[rel.handle];
+			if (dsa) {
+				glCopyNamedBufferSubData(page.buffer.id(), fresh.buffer.id(), rel.oldOffset, rel.newOffset, range.size);
+			} else {
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, rel.oldOffset, rel.newOffset, range.size);
+			}
+			range.block = blocks[i];
+			range.offset = rel.newOffset;
+		}
+
+		if (!dsa) {
+			StateCache::get().bindBuffer(GL_COPY_READ_BUFFER, 0);
+			StateCache::get().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+
+		page.buffer.destroy();
+		page = std::move(fresh);
+		relocations.insert(relocations.end(), moved.begin(), moved.end());
+	}
+
+	return relocations;
+}
+
+GpuHeap::Stats GpuHeap::stats() const {
+	Stats st;
+	st.pages = u32(m_pages.size());
+	st.allocations = u32(m_ranges.size() - m_unusedHandles.size());
+
+	u64 free = 0, largest = 0;
+	for (auto&& page : m_pages) {
+		const u32 pageLargest = page.allocator.largestFree();
+		st.capacity += page.allocator.capacity();
+		st.used += page.allocator.used();
+		st.freeBlocks += page.allocator.freeBlocks();
+		st.largestFree = std::max(st.largestFree, u64(pageLargest));
+		free += page.allocator.capacity() - page.allocator.used();
+		largest += pageLargest;
+	}
+
+	if (free > 0) {
+		st.fragmentation = 1.0f - f32(largest) / f32(free);
+	}
+	return st;
+}
@@ -0,0 +1,149 @@
+#ifndef GFXE_HEAP_H
+#define GFXE_HEAP_H
+
+#include <vector>
+#include <array>
+
+#include "buffer.h"
+
+// Two-level segregated fit allocator over an abstract range of bytes.
+// It only tracks offsets; the memory itself lives in a GL buffer.
+class TlsfAllocator {
+public:
+	static constexpr u32 InvalidBlock = ~0u;
+
+	TlsfAllocator() = default;
+	~TlsfAllocator() = default;
+
+	void create(u32 size, u32 granularity = 16);
+
+	u32 allocate(u32 size);
+	void free(u32 block);
+
+	u32 offset(u32 block) const { return m_blocks[block].offset; }
+	u32 size(u32 block) const { return m_blocks[block].size; }
+
+	u32 capacity() const { return m_capacity; }
+	u32 used() const { return m_used; }
+	u32 freeBlocks() const { return m_freeBlocks; }
+	u32 largestFree() const;
+
+private:
+	static constexpr u32 SLLog2 = 4;
+	static constexpr u32 SLCount = 1 << SLLog2;
+	static constexpr u32 FLCount = 32;
+
+	struct Block {
+		u32 offset, size;
+		u32 prevPhys, nextPhys;
+		u32 prevFree, nextFree;
+		bool free;
+	};
+
+	std::vector<Block> m_blocks;
+	std::vector<u32> m_unusedBlocks;
+
+	u32 m_flBitmap{ 0 };
+	std::array<u32, FLCount> m_slBitmap{};
+	std::array<std::array<u32, SLCount>, FLCount> m_heads{};
+
+	u32 m_capacity{ 0 }, m_used{ 0 }, m_freeBlocks{ 0 }, m_granularity{ 16 };
+
+	u32 newBlock();
+	void mapping(u32 size, u32& fl, u32& sl) const;
+	void insertFree(u32 block);
+	void removeFree(u32 block);
+};
+
+// Persistent sub-allocator for long-lived vertex and index data. Ranges come
+// from a few large pages, so many meshes share one buffer and one binding.
+class GpuHeap {
+public:
+	using Handle = u32;
+	static constexpr Handle InvalidHandle = ~0u;
+
+	struct Stats {
+		u32 pages{ 0 };
+		u32 allocations{ 0 };
+		u32 freeBlocks{ 0 };
+		u64 capacity{ 0 };
+		u64 used{ 0 };
+		u64 largestFree{ 0 };
+
+		// 0 when all free space is one block, approaching 1 as it splinters.
+		f32 fragmentation{ 0.0f };
+	};
+
+	struct Relocation {
+		Handle handle;
+		u32 oldPage, oldOffset;
+		u32 newPage, newOffset;
+	};
+
+	GpuHeap() = default;
+	~GpuHeap() = default;
+
+	GpuHeap& create(Buffer::BufferType type, u32 pageSize, u32 granularity = 16);
+	void destroy();
+
+	Handle allocate(u32 size, u32 alignment = 0);
+	void free(Handle handle);
+
+	template <typename DataType>
+	inline Handle upload(const std::vector<DataType>& data, u32 alignment = 0) {
+		Handle handle = allocate(u32(sizeof(DataType) * data.size()), alignment);
+		if (handle != InvalidHandle) {
+			update(handle, data);
+		}
+		return handle;
+	}
+
+	template <typename DataType>
+	inline GpuHeap& update(Handle handle, const std::vector<DataType>& data, u32 offset = 0) {
+		const Range& range = m_ranges[handle];
+		const u32 size = u32(sizeof(DataType) * data.size());
+		if (offset + size <= range.size) {
+			m_pages[range.page].buffer.updateRange(range.offset + offset, size, data.data());
+		}
+		return *this;
+	}
+
+	u32 page(Handle handle) const { return m_ranges[handle].page; }
+	u32 offset(Handle handle) const { return m_ranges[handle].offset; }
+	u32 size(Handle handle) const { return m_ranges[handle].size; }
+
+	Buffer& buffer(Handle handle) { return m_pages[m_ranges[handle].page].buffer; }
+	Buffer& pageBuffer(u32 page) { return m_pages[page].buffer; }
+	u32 pageCount() const { return u32(m_pages.size()); }
+
+	// Compacts every page whose fragmentation exceeds the threshold by copying
+	// its live ranges into a fresh buffer. Handles stay valid; offsets and
+	// buffer ids of the moved ranges change, as reported by the relocations.
+	std::vector<Relocation> defragment(f32 threshold = 0.25f);
+
+	Stats stats() const;
+
+private:
+	struct Page {
+		Buffer buffer;
+		TlsfAllocator allocator;
+	};
+
+	struct Range {
+		u32 page, block;
+		u32 offset, size, alignment;
+		bool live;
+	};
+
+	std::vector<Page> m_pages;
+	std::vector<Range> m_ranges;
+	std::vector<Handle> m_unusedHandles;
+
+	Buffer::BufferType m_type{ Buffer::ArrayBuffer };
+	u32 m_pageSize{ 0 }, m_granularity{ 16 };
+
+	u32 addPage(u32 size);
+	bool place(Page& page, u32 size, u32 alignment, u32& block, u32& offset);
+};
+
+#endif // GFXE_HEAP_H
@@ -0,0 +1,138 @@
+#ifndef GFXE_LAYOUT_H
+#define GFXE_LAYOUT_H
+
+#include <array>
+#include <utility>
+
+#include "buffer.h"
+
+enum AttrFlag : u8 {
+	AttrPlain = 0,
+	AttrNormalized = 1
+};
+
+constexpr u32 dataTypeSize(DataType type) {
+	switch (type) {
+		case DataType::TypeUByte:
+		case DataType::TypeByte: return 1;
+		case DataType::TypeUShort:
+		case DataType::TypeShort:
+		case DataType::TypeHalfFloat: return 2;
+		case DataType::TypeUInt:
+		case DataType::TypeInt:
+		case DataType::TypeFloat:
+		case DataType::TypeFixed:
+		case DataType::TypeInt2101010Rev:
+		case DataType::TypeUInt2101010Rev: return 4;
+		default: return 0;
+	}
+}
+
+constexpr bool isPackedType(DataType type) {
+	return type == DataType::TypeInt2101010Rev || type == DataType::TypeUInt2101010Rev;
+}
+
+constexpr bool isFloatType(DataType type) {
+	return type == DataType::TypeFloat || type == DataType::TypeHalfFloat || type == DataType::TypeFixed;
+}
+
+// One vertex attribute: Size components of Type.
+template <u8 Size, DataType Type, AttrFlag Flags = AttrPlain>
+struct Attr {
+	static_assert(Size >= 1 && Size <= 4, "Attr: size must be 1 to 4 components");
+	static_assert(dataTypeSize(Type) > 0, "Attr: unsupported data type");
+	static_assert(!(Flags & AttrNormalized) || !isFloatType(Type), "Attr: only integer types can be normalized");
+	static_assert(!isPackedType(Type) || Size == 4, "Attr: packed 2_10_10_10 types need 4 components");
+
+	static constexpr u8 size = Size;
+	static constexpr DataType type = Type;
+	static constexpr bool normalized = (Flags & AttrNormalized) != 0;
+	static constexpr u32 bytes = isPackedType(Type) ? dataTypeSize(Type) : u32(Size) * dataTypeSize(Type);
+};
+
+// Compile-time counterpart of VertexFormat. Offsets and stride are folded
+// into constants and enable() expands to one call per attribute, e.g.
+//
+//	using Layout = VertexLayout<Attr<3, TypeFloat>, Attr<2, TypeHalfFloat>, Attr<4, TypeUByte, AttrNormalized>>;
+//	static_assert(Layout::describes<Vertex>());
+template <typename... Attrs>
+class VertexLayout {
+public:
+	static constexpr u32 count = sizeof...(Attrs);
+	static constexpr u32 stride = (Attrs::bytes + ... + 0);
+
+	static_assert(count > 0, "VertexLayout: no attributes");
+	static_assert(count <= 16, "VertexLayout: more attributes than GL guarantees");
+	static_assert(stride <= 2048, "VertexLayout: stride exceeds GL_MAX_VERTEX_ATTRIB_STRIDE minimum");
+
+	static constexpr std::array<u32, count> offsets = [] {
+		constexpr u32 bytes[] = { Attrs::bytes... };
+		std::array<u32, count> off{};
+		u32 at = 0;
+		for (u32 i = 0; i < count; i++) {
+			off[i] = at;
+			at += bytes[i];
+		}
+		return off;
+	}();
+
+	// True when Vertex is exactly one layout stride wide.
+	template <typename Vertex>
+	static constexpr bool describes() { return sizeof(Vertex) == stride; }
+
+	// Pointer setup against the currently bound VAO and array buffer.
+	static void enable() {
+		enablePointers(std::index_sequence_for<Attrs...>{});
+	}
+
+	// Separate attribute format setup, sourcing every attribute from one
+	// buffer binding. Uses DSA when available.
+	static void enable(VertexArray& vao, const Buffer& buffer, u32 binding = 0, u32 offset = 0) {
+		if (Caps::directStateAccess()) {
+			enableNamed(vao.id(), binding, std::index_sequence_for<Attrs...>{});
+			glVertexArrayVertexBuffer(vao.id(), binding, buffer.id(), offset, stride);
+		} else {
+			vao.bind();
+			enableFormat(binding, std::index_sequence_for<Attrs...>{});
+			glBindVertexBuffer(binding, buffer.id(), offset, stride);
+		}
+	}
+
+	static void disable() {
+		for (u32 i = 0; i < count; i++) {
+			glDisableVertexAttribArray(i);
+		}
+	}
+
+private:
+	template <size_t... I>
+	static void enablePointers(std::index_sequence<I...>) {
+		((
+			glEnableVertexAttribArray(I),
+			glVertexAttribPointer(
+				I, Attrs::size, Attrs::type, Attrs::normalized, stride,
+				reinterpret_cast<const void*>(uintptr_t(offsets[I]))
+			)
+		), ...);
+	}
+
+	template <size_t... I>
+	static void enableNamed(GLuint vao, u32 binding, std::index_sequence<I...>) {
+		((
+			glEnableVertexArrayAttrib(vao, I),
+			glVertexArrayAttribFormat(vao, I, Attrs::size, Attrs::type, Attrs::normalized, offsets[I]),
+			glVertexArrayAttribBinding(vao, I, binding)
+		), ...);
+	}
+
+	template <size_t... I>
+	static void enableFormat(u32 binding, std::index_sequence<I...>) {
+		((
+			glEnableVertexAttribArray(I),
+			glVertexAttribFormat(I, Attrs::size, Attrs::type, Attrs::normalized, offsets[I]),
+			glVertexAttribBinding(I, binding)
+		), ...);
+	}
+};
+
+#endif // GFXE_LAYOUT_H
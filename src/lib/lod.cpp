@@ -0,0 +1,277 @@
+#include "lod.h"
+#include "optimize.h"
+
+#include <cmath>
+#include <algorithm>
+
+struct Quadric {
+	f64 a2{ 0 }, ab{ 0 }, ac{ 0 }, ad{ 0 };
+	f64 b2{ 0 }, bc{ 0 }, bd{ 0 };
+	f64 c2{ 0 }, cd{ 0 };
+	f64 d2{ 0 };
+	f64 weight{ 0 };
+
+	void add(const Quadric& q) {
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+		weight += q.weight;
+	}
+
+	// Mean squared distance of p to the accumulated planes.
+	f64 error(const f32* p) const {
+		const f64 x = p[0], y = p[1], z = p[2];
+		const f64 e =
+			a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+			b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+			c2 * z * z + 2.0 * cd * z +
+			d2;
+		return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+	}
+};
+
+static void cross(const f32* a, const f32* b, const f32* c, f64* n) {
+	const f64 e0[] = { f64(b[0]) - a[0], f64(b[1]) - a[1], f64(b[2]) - a[2] };
+	const f64 e1[] = { f64(c[0]) - a[0], f64(c[1]) - a[1], f64(c[2]) - a[2] };
+	n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+	n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+	n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+f32 simplify(
+	const std::vector<u32>& indices,
+	const f32* positions, u32 positionStride, u32 vertexCount,
+	u32 targetIndexCount, f32 targetError,
+	std::vector<u32>& out
+) {
+	auto position = [&](u32 v) {
+		return reinterpret_cast<const f32*>(reinterpret_cast<const u8*>(positions) + size_t(v) * positionStride);
+	};
+
+	out = indices;
+	if (out.size() <= targetIndexCount) {
+		return 0.0f;
+	}
+
+	// Area-weighted plane quadrics per vertex.
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t + 2 < out.size(); t += 3) {
+		f64 n[3];
+		cross(position(out[t]), position(out[t + 1]), position(out[t + 2]), n);
+		const f64 len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (len <= 0.0) continue;
+
+		const f64 a = n[0] / len, b = n[1] / len, c = n[2] / len;
+		const f32* p = position(out[t]);
+		const f64 d = -(a * p[0] + b * p[1] + c * p[2]);
+		const f64 w = len * 0.5;
+
+		Quadric q;
+		q.a2 = a * a * w; q.ab = a * b * w; q.ac = a * c * w; q.ad = a * d * w;
+		q.b2 = b * b * w; q.bc = b * c * w; q.bd = b * d * w;
+		q.c2 = c * c * w; q.cd = c * d * w;
+		q.d2 = d * d * w;
+		q.weight = w;
+
+		for (u32 k = 0; k < 3; k++) quadrics[out[t + k]].add(q);
+	}
+
+	// Vertices on edges used by a single triangle stay put.
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::vector<u64> edges;
+		edges.reserve(out.size());
+		for (size_t t = 0; t + 2 < out.size(); t += 3) {
+			for (u32 k = 0; k < 3; k++) {
+				const u32 a = out[t + k], b = out[t + (k + 1) % 3];
+				edges.push_back((u64(std::min(a, b)) << 32) | std::max(a, b));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0; i < edges.size();) {
+			size_t j = i + 1;
+			while (j < edges.size() && edges[j] == edges[i]) j++;
+			if (j - i == 1) {
+				locked[u32(edges[i] >> 32)] = true;
+				locked[u32(edges[i] & 0xffffffffu)] = true;
+			}
+			i = j;
+		}
+	}
+
+	struct Collapse {
+		u32 from, to;
+		f64 cost;
+	};
+
+	std::vector<u32> offsets(vertexCount + 1), adjacency, remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<Collapse> collapses;
+
+	const f64 maxCost = f64(targetError) * f64(targetError);
+	f64 reached = 0.0;
+
+	while (out.size() > targetIndexCount) {
+		const u32 triCount = u32(out.size() / 3);
+
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (u32 v : out) offsets[v + 1]++;
+		for (u32 v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+		adjacency.resize(out.size());
+		{
+			std::vector<u32> fill(offsets.begin(), offsets.end() - 1);
+			for (u32 t = 0; t < triCount; t++) {
+				for (u32 k = 0; k < 3; k++) adjacency[fill[out[t * 3 + k]]++] = t;
+			}
+		}
+
+		collapses.clear();
+		for (u32 t = 0; t < triCount; t++) {
+			for (u32 k = 0; k < 3; k++) {
+				const u32 a = out[t * 3 + k], b = out[t * 3 + (k + 1) % 3];
+				if (a > b) continue;
+
+				Quadric q = quadrics[a];
+				q.add(quadrics[b]);
+
+				const f64 costAB = locked[a] ? 1e300 : q.error(position(b));
+				const f64 costBA = locked[b] ? 1e300 : q.error(position(a));
+				if (locked[a] && locked[b]) continue;
+
+				if (costAB <= costBA) collapses.push_back(Collapse{ a, b, costAB });
+				else collapses.push_back(Collapse{ b, a, costBA });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+			return x.cost < y.cost;
+		});
+
+		for (u32 v = 0; v < vertexCount; v++) remap[v] = v;
+		std::fill(touched.begin(), touched.end(), false);
+
+		// Each collapse removes about two triangles.
+		const u32 budget = u32((out.size() - targetIndexCount) / 6) + 1;
+		u32 applied = 0;
+
+		for (const Collapse& c : collapses) {
+			if (applied >= budget || c.cost > maxCost) break;
+			if (touched[c.from] || touched[c.to]) continue;
+
+			// Reject collapses that would flip a surrounding triangle.
+			bool flips = false;
+			for (u32 a = offsets[c.from]; a < offsets[c.from + 1] && !flips; a++) {
+				const u32* tri = &out[adjacency[a] * 3];
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) continue;
+
+				const f32* p[3];
+				const f32* q[3];
+				for (u32 k = 0; k < 3; k++) {
+					p[k] = position(tri[k]);
+					q[k] = tri[k] == c.from ? position(c.to) : p[k];
+				}
+				f64 n0[3], n1[3];
+				cross(p[0], p[1], p[2], n0);
+				cross(q[0], q[1], q[2], n1);
+				flips = (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2]) <= 0.0;
+			}
+			if (flips) continue;
+
+			remap[c.from] = c.to;
+			for (u32 a = offsets[c.from]; a < offsets[c.from + 1]; a++) {
+				const u32* tri = &out[adjacency[a] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+			}
+			touched[c.to] = true;
+
+			quadrics[c.to].add(quadrics[c.from]);
+			reached = std::max(reached, c.cost);
+			applied++;
+		}
+
+		if (applied == 0) {
+			break;
+		}
+
+		size_t w = 0;
+		for (size_t t = 0; t + 2 < out.size(); t += 3) {
+			const u32 a = remap[out[t]], b = remap[out[t + 1]], c = remap[out[t + 2]];
+			if (a == b || b == c || a == c) continue;
+			out[w++] = a;
+			out[w++] = b;
+			out[w++] = c;
+		}
+		out.resize(w);
+	}
+
+	return f32(std::sqrt(reached));
+}
+
+LodChain& LodChain::create(
+	const std::vector<u32>& indices,
+	const f32* positions, u32 positionStride, u32 vertexCount,
+	u32 levels, f32 ratio, f32 maxError
+) {
+	destroy();
+	if (indices.empty()) {
+		return *this;
+	}
+
+	m_indices = indices;
+	m_levels.push_back(Level{ 0, u32(indices.size()), 0.0f });
+
+	std::vector<u32> lod;
+	for (u32 i = 1; i < levels; i++) {
+		const u32 previous = m_levels.back().indexCount;
+		const u32 target = (u32(f32(previous) * ratio) / 3) * 3;
+
+		// Simplify from the full mesh each time so errors don't compound.
+		const f32 error = simplify(indices, positions, positionStride, vertexCount, target, maxError, lod);
+		if (lod.empty() || lod.size() >= size_t(previous) * 95 / 100) {
+			break;
+		}
+
+		optimizeVertexCache(lod, vertexCount);
+
+		Level level;
+		level.firstIndex = u32(m_indices.size());
+		level.indexCount = u32(lod.size());
+		level.error = std::max(error, m_levels.back().error);
+		m_levels.push_back(level);
+
+		m_indices.insert(m_indices.end(), lod.begin(), lod.end());
+	}
+
+	m_buffer.create(Buffer::ElementBuffer)
+		.storage(u32(m_indices.size() * sizeof(u32)), 0, m_indices.data());
+
+	return *this;
+}
+
+void LodChain::destroy() {
+	m_buffer.destroy();
+	m_levels.clear();
+	m_indices.clear();
+}
+
+u32 LodChain::select(f32 distance, f32 viewportHeight, f32 fovY, f32 pixelError) const {
+	// Pixels covered by one mesh unit at this distance.
+	const f32 scale = viewportHeight / (2.0f * std::max(distance, 1e-6f) * std::tan(fovY * 0.5f));
+
+	u32 lod = 0;
+	for (u32 i = 1; i < m_levels.size(); i++) {
+		if (m_levels[i].error * scale > pixelError) break;
+		lod = i;
+	}
+	return lod;
+}
+
+DrawElementsIndirectCommand LodChain::command(u32 level, i32 baseVertex, u32 instances, u32 baseInstance) const {
+	DrawElementsIndirectCommand cmd;
+	cmd.count = m_levels[level].indexCount;
+	cmd.instanceCount = instances;
+	cmd.firstIndex = m_levels[level].firstIndex;
+	cmd.baseVertex = baseVertex;
+	cmd.baseInstance = baseInstance;
+	return cmd;
+}
@@ -0,0 +1,59 @@
+#ifndef GFXE_LOD_H
+#define GFXE_LOD_H
+
+#include <vector>
+
+#include "batch.h"
+
+// Quadric edge-collapse simplification that only moves vertices onto
+// existing ones, so every result indexes the original vertex buffer.
+// Border edges are locked to keep open meshes and UV seams intact.
+// Returns the reached error, an approximate distance in mesh units.
+f32 simplify(
+	const std::vector<u32>& indices,
+	const f32* positions, u32 positionStride, u32 vertexCount,
+	u32 targetIndexCount, f32 targetError,
+	std::vector<u32>& out
+);
+
+// A mesh's LOD index lists, stored back to back in one element buffer.
+class LodChain {
+public:
+	struct Level {
+		u32 firstIndex;
+		u32 indexCount;
+		f32 error;
+	};
+
+	LodChain() = default;
+	~LodChain() = default;
+
+	// Level 0 is the input; each further level aims for `ratio` of the
+	// previous index count and stops early once the mesh will not shrink.
+	LodChain& create(
+		const std::vector<u32>& indices,
+		const f32* positions, u32 positionStride, u32 vertexCount,
+		u32 levels = 4, f32 ratio = 0.5f, f32 maxError = 1e30f
+	);
+	void destroy();
+
+	// Coarsest level whose error, projected at the given distance, stays
+	// under pixelError pixels. fovY is the vertical field of view in radians.
+	u32 select(f32 distance, f32 viewportHeight, f32 fovY, f32 pixelError = 1.0f) const;
+
+	DrawElementsIndirectCommand command(u32 level, i32 baseVertex = 0, u32 instances = 1, u32 baseInstance = 0) const;
+
+	const Level& level(u32 i) const { return m_levels[i]; }
+	u32 levelCount() const { return u32(m_levels.size()); }
+	u32 byteOffset(u32 i) const { return m_levels[i].firstIndex * sizeof(u32); }
+
+	const std::vector<u32>& indices() const { return m_indices; }
+	Buffer& buffer() { return m_buffer; }
+
+private:
+	Buffer m_buffer;
+	std::vector<Level> m_levels;
+	std::vector<u32> m_indices;
+};
+
+#endif // GFXE_LOD_H
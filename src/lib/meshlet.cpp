@@ -0,0 +1,227 @@
+#include "meshlet.h"
+#include "state.h"
+#include "hash.h"
+
+#include <cmath>
+#include <algorithm>
+
+static const u32 GroupSize = 64;
+
+static const std::string MeshletCullSource = R"(#version 430 core
+layout (local_size_x = 64) in;
+
+struct Meshlet {
+	vec4 sphere;
+	vec4 cone;
+	uint firstIndex;
+	uint indexCount;
+	uint vertexCount;
+	uint triangleCount;
+};
+
+struct Command {
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };
+layout (std430, binding = 1) writeonly buffer Commands { Command commands[]; };
+layout (binding = 0, offset = 0) uniform atomic_uint uVisible;
+
+uniform vec4 uPlanes[6];
+uniform vec3 uCamera;
+uniform uint uMeshletCount;
+uniform int uBaseVertex;
+uniform uint uBaseInstance;
+
+void main() {
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= uMeshletCount) return;
+
+	Meshlet m = meshlets[i];
+	for (int p = 0; p < 6; p++) {
+		if (dot(uPlanes[p].xyz, m.sphere.xyz) + uPlanes[p].w < -m.sphere.w) return;
+	}
+
+	// Every triangle faces away from the camera.
+	vec3 toCenter = m.sphere.xyz - uCamera;
+	if (dot(toCenter, m.cone.xyz) >= m.cone.w * length(toCenter) + m.sphere.w) return;
+
+	uint slot = atomicCounterIncrement(uVisible);
+	commands[slot] = Command(m.indexCount, 1u, m.firstIndex, uBaseVertex, uBaseInstance);
+}
+)";
+
+static void finishMeshlet(
+	Meshlet& m, const std::vector<u32>& indices,
+	const f32* positions, u32 positionStride
+) {
+	auto position = [&](u32 v) {
+		return reinterpret_cast<const f32*>(reinterpret_cast<const u8*>(positions) + size_t(v) * positionStride);
+	};
+
+	f32 lo[3] = { 1e30f, 1e30f, 1e30f }, hi[3] = { -1e30f, -1e30f, -1e30f };
+	f32 axis[3] = { 0.0f, 0.0f, 0.0f };
+	std::vector<f32> normals;
+	normals.reserve(m.triangleCount * 3);
+
+	for (u32 i = m.firstIndex; i < m.firstIndex + m.indexCount; i += 3) {
+		const f32* a = position(indices[i]);
+		const f32* b = position(indices[i + 1]);
+		const f32* c = position(indices[i + 2]);
+		for (const f32* p : { a, b, c }) {
+			for (u32 k = 0; k < 3; k++) {
+				lo[k] = std::min(lo[k], p[k]);
+				hi[k] = std::max(hi[k], p[k]);
+			}
+		}
+
+		const f32 e0[] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		const f32 e1[] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		f32 n[] = {
+			e0[1] * e1[2] - e0[2] * e1[1],
+			e0[2] * e1[0] - e0[0] * e1[2],
+			e0[0] * e1[1] - e0[1] * e1[0]
+		};
+		const f32 len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (len <= 0.0f) continue;
+
+		for (u32 k = 0; k < 3; k++) {
+			n[k] /= len;
+			axis[k] += n[k];
+			normals.push_back(n[k]);
+		}
+	}
+
+	for (u32 k = 0; k < 3; k++) m.center[k] = (lo[k] + hi[k]) * 0.5f;
+
+	f32 radius = 0.0f;
+	for (u32 i = m.firstIndex; i < m.firstIndex + m.indexCount; i++) {
+		const f32* p = position(indices[i]);
+		const f32 d[] = { p[0] - m.center[0], p[1] - m.center[1], p[2] - m.center[2] };
+		radius = std::max(radius, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	}
+	m.radius = std::sqrt(radius);
+
+	// The cone spans every triangle normal; past a hemisphere it can't cull.
+	const f32 axisLen = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	m.coneCutoff = 1.0f;
+	m.coneAxis[0] = m.coneAxis[1] = m.coneAxis[2] = 0.0f;
+	if (axisLen <= 0.0f || normals.empty()) {
+		return;
+	}
+
+	f32 minDot = 1.0f;
+	for (u32 k = 0; k < 3; k++) m.coneAxis[k] = axis[k] / axisLen;
+	for (size_t i = 0; i < normals.size(); i += 3) {
+		const f32 d = normals[i] * m.coneAxis[0] + normals[i + 1] * m.coneAxis[1] + normals[i + 2] * m.coneAxis[2];
+		minDot = std::min(minDot, d);
+	}
+	if (minDot > 0.0f) {
+		m.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+std::vector<Meshlet> buildMeshlets(
+	const std::vector<u32>& indices,
+	const f32* positions, u32 positionStride, u32 vertexCount,
+	u32 maxVertices, u32 maxTriangles
+) {
+	std::vector<Meshlet> meshlets;
+
+	// Last meshlet each vertex was counted in.
+	std::vector<u32> owner(vertexCount, ~0u);
+
+	Meshlet current{};
+	auto flush = [&]() {
+		if (current.triangleCount == 0) return;
+		finishMeshlet(current, indices, positions, positionStride);
+		meshlets.push_back(current);
+
+		const u32 next = current.firstIndex + current.indexCount;
+		current = Meshlet{};
+		current.firstIndex = next;
+	};
+
+	for (u32 t = 0; t + 2 < indices.size(); t += 3) {
+		const u32 id = u32(meshlets.size());
+		u32 fresh = 0;
+		for (u32 k = 0; k < 3; k++) {
+			const u32 v = indices[t + k];
+			const bool repeated = (k > 0 && v == indices[t]) || (k > 1 && v == indices[t + 1]);
+			if (owner[v] != id && !repeated) fresh++;
+		}
+
+		if (current.vertexCount + fresh > maxVertices || current.triangleCount + 1 > maxTriangles) {
+			flush();
+		}
+
+		const u32 target = u32(meshlets.size());
+		for (u32 k = 0; k < 3; k++) {
+			const u32 v = indices[t + k];
+			if (owner[v] != target) {
+				owner[v] = target;
+				current.vertexCount++;
+			}
+		}
+		current.indexCount += 3;
+		current.triangleCount++;
+	}
+	flush();
+
+	return meshlets;
+}
+
+MeshletCullPass& MeshletCullPass::create(u32 maxMeshlets) {
+	m_shader.create()
+		.add(MeshletCullSource, Shader::ComputeShader)
+		.link()
+		.wait();
+	m_uniforms.planes = m_shader.findUniform("uPlanes"_h);
+	m_uniforms.camera = m_shader.findUniform("uCamera"_h);
+	m_uniforms.meshletCount = m_shader.findUniform("uMeshletCount"_h);
+	m_uniforms.baseVertex = m_shader.findUniform("uBaseVertex"_h);
+	m_uniforms.baseInstance = m_shader.findUniform("uBaseInstance"_h);
+	m_output.create(maxMeshlets);
+	return *this;
+}
+
+void MeshletCullPass::destroy() {
+	m_shader.destroy();
+	m_output.destroy();
+}
+
+MeshletCullPass& MeshletCullPass::dispatch(
+	Buffer& meshlets, u32 meshletCount,
+	const f32* viewProj, const f32* cameraPosition,
+	i32 baseVertex, u32 baseInstance
+) {
+	f32 planes[24];
+	frustumPlanes(viewProj, planes);
+
+	m_output.begin(meshletCount, CommandBinding, CounterBinding);
+
+	m_shader.set(m_uniforms.planes, planes, 24)
+		.set(m_uniforms.camera, cameraPosition[0], cameraPosition[1], cameraPosition[2])
+		.set(m_uniforms.meshletCount, m_output.count())
+		.set(m_uniforms.baseVertex, baseVertex)
+		.set(m_uniforms.baseInstance, baseInstance)
+		.bind();
+
+	StateCache::get().bindBufferBase(GL_SHADER_STORAGE_BUFFER, MeshletBinding, meshlets.id());
+	m_output.dispatch(GroupSize);
+
+	return *this;
+}
+
+MeshletCullPass& MeshletCullPass::draw(Shader& shader, VertexArray& vao, PrimitiveType mode, DataType indexType) {
+	m_output.draw(shader, vao, mode, indexType);
+	return *this;
+}
+
+u32 MeshletCullPass::visible() {
+	return m_output.visible();
+}
@@ -0,0 +1,75 @@
+#ifndef GFXE_MESHLET_H
+#define GFXE_MESHLET_H
+
+#include <vector>
+
+#include "cull.h"
+
+// A small cluster of triangles, laid out to match the std430 struct read by
+// MeshletCullPass. Its triangles are indexCount consecutive indices starting
+// at firstIndex in the mesh's index buffer.
+struct Meshlet {
+	f32 center[3];
+	f32 radius;
+	f32 coneAxis[3];
+	f32 coneCutoff; // 1 when the normals are too spread out to cull
+	u32 firstIndex;
+	u32 indexCount;
+	u32 vertexCount;
+	u32 triangleCount;
+};
+
+// Splits an index buffer, in its existing order, into meshlets of at most
+// maxVertices unique vertices and maxTriangles triangles. Run
+// optimizeVertexCache first for tighter clusters.
+std::vector<Meshlet> buildMeshlets(
+	const std::vector<u32>& indices,
+	const f32* positions, u32 positionStride, u32 vertexCount,
+	u32 maxVertices = 64, u32 maxTriangles = 124
+);
+
+// Cluster culling on the GPU: frustum and normal cone tests per meshlet,
+// with one indirect draw command appended for each one that survives.
+class MeshletCullPass {
+public:
+	enum Binding {
+		MeshletBinding = 0,
+		CommandBinding = 1,
+		CounterBinding = 0
+	};
+
+	MeshletCullPass() = default;
+	~MeshletCullPass() = default;
+
+	MeshletCullPass& create(u32 maxMeshlets);
+	void destroy();
+
+	// meshlets holds meshletCount Meshlet entries. viewProj (column-major)
+	// and cameraPosition are in the mesh's model space.
+	MeshletCullPass& dispatch(
+		Buffer& meshlets, u32 meshletCount,
+		const f32* viewProj, const f32* cameraPosition,
+		i32 baseVertex = 0, u32 baseInstance = 0
+	);
+
+	MeshletCullPass& draw(Shader& shader, VertexArray& vao, PrimitiveType mode = PrimitiveType::Triangles, DataType indexType = DataType::TypeUInt);
+
+	// Reads the surviving meshlet count back; stalls until the dispatch completes.
+	u32 visible();
+
+	Buffer& commands() { return m_output.commands(); }
+	Buffer& counter() { return m_output.counter(); }
+
+private:
+	struct Uniforms {
+		u32 planes{ Shader::InvalidIndex }, camera{ Shader::InvalidIndex };
+		u32 meshletCount{ Shader::InvalidIndex };
+		u32 baseVertex{ Shader::InvalidIndex }, baseInstance{ Shader::InvalidIndex };
+	};
+
+	Shader m_shader;
+	IndirectOutput m_output;
+	Uniforms m_uniforms;
+};
+
+#endif // GFXE_MESHLET_H
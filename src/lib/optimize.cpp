@@ -0,0 +1,273 @@
+#include "optimize.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// FIFO cache simulation: a vertex is resident while fewer than cacheSize
+// misses have happened since it was loaded.
+class FifoCache {
+public:
+	FifoCache(u32 vertexCount, u32 cacheSize)
+		: m_stamps(vertexCount, 0), m_size(cacheSize), m_time(cacheSize + 1)
+	{}
+
+	bool access(u32 v) {
+		if (m_time - m_stamps[v] > m_size) {
+			m_stamps[v] = m_time++;
+			return true;
+		}
+		return false;
+	}
+
+	void flush() { m_time += m_size + 1; }
+
+private:
+	std::vector<u32> m_stamps;
+	u32 m_size, m_time;
+};
+
+CacheStats analyzeVertexCache(const std::vector<u32>& indices, u32 vertexCount, u32 cacheSize) {
+	CacheStats st;
+	st.triangles = u32(indices.size() / 3);
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> seen(vertexCount, false);
+	for (u32 idx : indices) {
+		if (cache.access(idx)) st.misses++;
+		if (!seen[idx]) {
+			seen[idx] = true;
+			st.vertices++;
+		}
+	}
+
+	if (st.triangles > 0) st.acmr = f32(st.misses) / f32(st.triangles);
+	if (st.vertices > 0) st.atvr = f32(st.misses) / f32(st.vertices);
+	return st;
+}
+
+void optimizeVertexCache(std::vector<u32>& indices, u32 vertexCount, u32 cacheSize) {
+	const u32 triCount = u32(indices.size() / 3);
+	if (triCount == 0 || vertexCount == 0) {
+		return;
+	}
+
+	// Vertex -> triangle adjacency, packed as offsets into one array.
+	std::vector<u32> live(vertexCount, 0), offsets(vertexCount + 1, 0);
+	for (u32 i = 0; i < triCount * 3; i++) live[indices[i]]++;
+	for (u32 v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + live[v];
+
+	std::vector<u32> adjacency(offsets[vertexCount]);
+	std::vector<u32> fill(offsets.begin(), offsets.end() - 1);
+	for (u32 t = 0; t < triCount; t++) {
+		for (u32 k = 0; k < 3; k++) {
+			adjacency[fill[indices[t * 3 + k]]++] = t;
+		}
+	}
+
+	std::vector<u32> stamps(vertexCount, 0), deadEnd, candidates;
+	std::vector<bool> emitted(triCount, false);
+	std::vector<u32> out;
+	out.reserve(triCount * 3);
+
+	u32 time = cacheSize + 1, cursor = 0;
+	i64 fan = 0;
+
+	while (fan >= 0) {
+		candidates.clear();
+
+		for (u32 a = offsets[fan]; a < offsets[fan + 1]; a++) {
+			const u32 t = adjacency[a];
+			if (emitted[t]) continue;
+
+			for (u32 k = 0; k < 3; k++) {
+				const u32 v = indices[t * 3 + k];
+				out.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - stamps[v] > cacheSize) {
+					stamps[v] = time++;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		// Prefer the candidate that stays in cache longest while still
+		// having enough triangles left to be worth fanning around.
+		i64 best = -1, bestPriority = -1;
+		for (u32 v : candidates) {
+			if (live[v] == 0) continue;
+			i64 priority = 0;
+			if (time - stamps[v] + 2 * live[v] <= cacheSize) {
+				priority = time - stamps[v];
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				best = v;
+			}
+		}
+
+		if (best < 0) {
+			while (!deadEnd.empty()) {
+				const u32 v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0) {
+					best = v;
+					break;
+				}
+			}
+		}
+
+		if (best < 0) {
+			while (cursor < vertexCount && live[cursor] == 0) cursor++;
+			if (cursor < vertexCount) best = cursor;
+		}
+
+		fan = best;
+	}
+
+	indices.swap(out);
+}
+
+void optimizeOverdraw(
+	std::vector<u32>& indices,
+	const f32* positions, u32 positionStride, u32 vertexCount,
+	f32 threshold, u32 cacheSize
+) {
+	const u32 triCount = u32(indices.size() / 3);
+	if (triCount == 0) {
+		return;
+	}
+
+	const f32 target = analyzeVertexCache(indices, vertexCount, cacheSize).acmr * threshold;
+
+	// Hard boundaries where the cache is effectively cold anyway, then soft
+	// boundaries inside each run wherever restarting keeps the ACMR on target.
+	std::vector<u32> clusters;
+	{
+		FifoCache cache(vertexCount, cacheSize);
+		FifoCache local(vertexCount, cacheSize);
+		u32 start = 0, localMisses = 0;
+
+		for (u32 t = 0; t < triCount; t++) {
+			u32 misses = 0;
+			for (u32 k = 0; k < 3; k++) {
+				misses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+			}
+
+			if (t == 0 || misses == 3) {
+				clusters.push_back(t);
+				start = t;
+				local.flush();
+				localMisses = 0;
+			}
+
+			for (u32 k = 0; k < 3; k++) {
+				localMisses += local.access(indices[t * 3 + k]) ? 1 : 0;
+			}
+
+			const u32 tris = t - start + 1;
+			if (t + 1 < triCount && f32(localMisses) / f32(tris) <= target && tris >= 8) {
+				clusters.push_back(t + 1);
+				start = t + 1;
+				local.flush();
+				localMisses = 0;
+			}
+		}
+	}
+	clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+	clusters.push_back(triCount);
+
+	auto position = [&](u32 v) {
+		return reinterpret_cast<const f32*>(reinterpret_cast<const u8*>(positions) + size_t(v) * positionStride);
+	};
+
+	f32 meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+	f32 meshArea = 0.0f;
+
+	const u32 clusterCount = u32(clusters.size() - 1);
+	std::vector<f32> centers(clusterCount * 3, 0.0f), normals(clusterCount * 3, 0.0f), areas(clusterCount, 0.0f);
+
+	for (u32 c = 0; c < clusterCount; c++) {
+		for (u32 t = clusters[c]; t < clusters[c + 1]; t++) {
+			const f32* a = position(indices[t * 3 + 0]);
+			const f32* b = position(indices[t * 3 + 1]);
+			const f32* d = position(indices[t * 3 + 2]);
+
+			const f32 e0[] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			const f32 e1[] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+			const f32 n[] = {
+				e0[1] * e1[2] - e0[2] * e1[1],
+				e0[2] * e1[0] - e0[0] * e1[2],
+				e0[0] * e1[1] - e0[1] * e1[0]
+			};
+			const f32 area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (u32 k = 0; k < 3; k++) {
+				const f32 centroid = (a[k] + b[k] + d[k]) / 3.0f;
+				centers[c * 3 + k] += centroid * area;
+				normals[c * 3 + k] += n[k];
+				meshCenter[k] += centroid * area;
+			}
+			areas[c] += area;
+			meshArea += area;
+		}
+	}
+
+	if (meshArea > 0.0f) {
+		for (u32 k = 0; k < 3; k++) meshCenter[k] /= meshArea;
+	}
+
+	// Clusters lying further out along their own normal tend to occlude the
+	// rest of the mesh, so they are drawn first.
+	std::vector<f32> sortKeys(clusterCount, 0.0f);
+	for (u32 c = 0; c < clusterCount; c++) {
+		f32* n = &normals[c * 3];
+		const f32 len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (areas[c] <= 0.0f || len <= 0.0f) continue;
+
+		f32 dot = 0.0f;
+		for (u32 k = 0; k < 3; k++) {
+			dot += (centers[c * 3 + k] / areas[c] - meshCenter[k]) * (n[k] / len);
+		}
+		sortKeys[c] = dot;
+	}
+
+	std::vector<u32> order(clusterCount);
+	for (u32 c = 0; c < clusterCount; c++) order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	std::vector<u32> out;
+	out.reserve(indices.size());
+	for (u32 c : order) {
+		out.insert(out.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	}
+	indices.swap(out);
+}
+
+u32 optimizeVertexFetch(std::vector<u32>& indices, void* vertices, u32 vertexCount, u32 vertexSize) {
+	const u32 Unused = ~0u;
+	std::vector<u32> remap(vertexCount, Unused);
+
+	u32 next = 0;
+	for (u32& idx : indices) {
+		if (remap[idx] == Unused) {
+			remap[idx] = next++;
+		}
+		idx = remap[idx];
+	}
+
+	u8* data = reinterpret_cast<u8*>(vertices);
+	std::vector<u8> sorted(size_t(next) * vertexSize);
+	for (u32 v = 0; v < vertexCount; v++) {
+		if (remap[v] != Unused) {
+			std::memcpy(&sorted[size_t(remap[v]) * vertexSize], data + size_t(v) * vertexSize, vertexSize);
+		}
+	}
+	std::memcpy(data, sorted.data(), sorted.size());
+
+	return next;
+}
@@ -0,0 +1,70 @@
+#ifndef GFXE_OPTIMIZE_H
+#define GFXE_OPTIMIZE_H
+
+#include <vector>
+
+#include "integer.h"
+
+// Post-transform vertex cache behaviour of an index buffer, as seen by a
+// FIFO cache of the given size. ACMR is misses per triangle (0.5 at best,
+// 3 at worst), ATVR misses per referenced vertex (1 is perfect).
+struct CacheStats {
+	u32 triangles{ 0 };
+	u32 vertices{ 0 };
+	u32 misses{ 0 };
+	f32 acmr{ 0.0f };
+	f32 atvr{ 0.0f };
+};
+
+struct OptimizeReport {
+	CacheStats before, after;
+	u32 verticesBefore{ 0 }, verticesAfter{ 0 };
+};
+
+CacheStats analyzeVertexCache(const std::vector<u32>& indices, u32 vertexCount, u32 cacheSize = 16);
+
+// Reorders triangles for vertex cache locality (Tipsify, Sander et al. 2007).
+void optimizeVertexCache(std::vector<u32>& indices, u32 vertexCount, u32 cacheSize = 16);
+
+// Splits a cache-optimized index buffer into clusters and orders them so
+// outward-facing ones are drawn first, trading at most `threshold` times
+// the current ACMR for less overdraw. positionStride is in bytes.
+void optimizeOverdraw(
+	std::vector<u32>& indices,
+	const f32* positions, u32 positionStride, u32 vertexCount,
+	f32 threshold = 1.05f, u32 cacheSize = 16
+);
+
+// Reorders vertices by first use and rewrites the indices to match.
+// Unreferenced vertices are dropped; returns the new vertex count.
+u32 optimizeVertexFetch(std::vector<u32>& indices, void* vertices, u32 vertexCount, u32 vertexSize);
+
+template <typename Vertex>
+inline u32 optimizeVertexFetch(std::vector<u32>& indices, std::vector<Vertex>& vertices) {
+	const u32 count = optimizeVertexFetch(indices, vertices.data(), u32(vertices.size()), sizeof(Vertex));
+	vertices.resize(count);
+	return count;
+}
+
+// Runs cache, overdraw and fetch optimization in that order. The vertex
+// position is read as three floats at positionOffset bytes into Vertex.
+template <typename Vertex>
+inline OptimizeReport optimizeMesh(std::vector<u32>& indices, std::vector<Vertex>& vertices, u32 positionOffset = 0, u32 cacheSize = 16) {
+	OptimizeReport report;
+	report.verticesBefore = u32(vertices.size());
+	report.before = analyzeVertexCache(indices, u32(vertices.size()), cacheSize);
+
+	optimizeVertexCache(indices, u32(vertices.size()), cacheSize);
+
+	const u8* base = reinterpret_cast<const u8*>(vertices.data()) + positionOffset;
+	optimizeOverdraw(
+		indices, reinterpret_cast<const f32*>(base), sizeof(Vertex), u32(vertices.size()),
+		1.05f, cacheSize
+	);
+
+	report.verticesAfter = optimizeVertexFetch(indices, vertices);
+	report.after = analyzeVertexCache(indices, u32(vertices.size()), cacheSize);
+	return report;
+}
+
+#endif // GFXE_OPTIMIZE_H
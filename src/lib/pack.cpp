@@ -0,0 +1,307 @@
+#include "pack.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GFXE_PACK_SSE2 1
+#include <emmintrin.h>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+#endif
+
+const char* const OctahedralDecodeGLSL = R"(
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+	return normalize(n);
+}
+)";
+
+static u32 floatBits(f32 v) { u32 u; std::memcpy(&u, &v, 4); return u; }
+static f32 bitsFloat(u32 u) { f32 v; std::memcpy(&v, &u, 4); return v; }
+
+// Round-to-nearest-even float to half, after Fabian Giesen's float_to_half_fast3.
+u16 packHalf(f32 v) {
+	const u32 f32Infty = 255u << 23;
+	const u32 f16Max = (127u + 16u) << 23;
+	const u32 denormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+	u32 u = floatBits(v);
+	const u32 sign = u & 0x80000000u;
+	u ^= sign;
+
+	u32 o;
+	if (u >= f16Max) {
+		o = (u > f32Infty) ? 0x7e00 : 0x7c00;
+	} else if (u < (113u << 23)) {
+		o = floatBits(bitsFloat(u) + bitsFloat(denormMagic)) - denormMagic;
+	} else {
+		const u32 mantOdd = (u >> 13) & 1;
+		u += 0xC8000FFFu; // ((15 - 127) << 23) + 0xfff
+		u += mantOdd;
+		o = u >> 13;
+	}
+	return u16(o | (sign >> 16));
+}
+
+f32 unpackHalf(u16 v) {
+	const u32 shiftedExp = 0x7c00u << 13;
+
+	u32 o = u32(v & 0x7fff) << 13;
+	const u32 exp = o & shiftedExp;
+	o += (127u - 15u) << 23;
+
+	if (exp == shiftedExp) {
+		o += (128u - 16u) << 23;
+	} else if (exp == 0) {
+		o += 1u << 23;
+		o = floatBits(bitsFloat(o) - bitsFloat(113u << 23));
+	}
+	return bitsFloat(o | (u32(v & 0x8000) << 16));
+}
+
+static i32 snorm(f32 v, f32 scale) {
+	return i32(std::lrint(std::clamp(v, -1.0f, 1.0f) * scale));
+}
+
+u32 packSnorm2101010(f32 x, f32 y, f32 z, f32 w) {
+	return (u32(snorm(x, 511.0f)) & 0x3ff)
+		| ((u32(snorm(y, 511.0f)) & 0x3ff) << 10)
+		| ((u32(snorm(z, 511.0f)) & 0x3ff) << 20)
+		| ((u32(snorm(w, 1.0f)) & 0x3) << 30);
+}
+
+// Follows the sign bit, so -0.0 maps to -1 exactly as signNotZerox4 does.
+static f32 signNotZero(f32 v) {
+	return std::copysign(1.0f, v);
+}
+
+void packOctahedral(const f32* normal, i16* out) {
+	const f32 l1 = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+	const f32 inv = 1.0f / std::max(l1, 1e-20f);
+
+	f32 x = normal[0] * inv, y = normal[1] * inv;
+	if (normal[2] < 0.0f) {
+		const f32 wx = (1.0f - std::abs(y)) * signNotZero(x);
+		const f32 wy = (1.0f - std::abs(x)) * signNotZero(y);
+		x = wx;
+		y = wy;
+	}
+	out[0] = i16(snorm(x, 32767.0f));
+	out[1] = i16(snorm(y, 32767.0f));
+}
+
+void unpackOctahedral(const i16* in, f32* normal) {
+	f32 x = std::max(f32(in[0]) / 32767.0f, -1.0f);
+	f32 y = std::max(f32(in[1]) / 32767.0f, -1.0f);
+	const f32 z = 1.0f - std::abs(x) - std::abs(y);
+	if (z < 0.0f) {
+		const f32 wx = (1.0f - std::abs(y)) * signNotZero(x);
+		const f32 wy = (1.0f - std::abs(x)) * signNotZero(y);
+		x = wx;
+		y = wy;
+	}
+	const f32 len = std::sqrt(x * x + y * y + z * z);
+	normal[0] = x / len;
+	normal[1] = y / len;
+	normal[2] = z / len;
+}
+
+static void packVertex(const MeshSource& mesh, u32 i, PackedVertex& out) {
+	const f32* p = mesh.positions + i * 3;
+	out.position[0] = packHalf(p[0]);
+	out.position[1] = packHalf(p[1]);
+	out.position[2] = packHalf(p[2]);
+	out.position[3] = packHalf(1.0f);
+
+	const f32 up[] = { 0.0f, 0.0f, 1.0f };
+	packOctahedral(mesh.normals ? mesh.normals + i * 3 : up, out.normal);
+
+	if (mesh.tangents) {
+		const f32* t = mesh.tangents + i * 4;
+		out.tangent = packSnorm2101010(t[0], t[1], t[2], t[3]);
+	} else {
+		out.tangent = packSnorm2101010(1.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	if (mesh.uvs) {
+		out.uv[0] = packHalf(mesh.uvs[i * 2 + 0]);
+		out.uv[1] = packHalf(mesh.uvs[i * 2 + 1]);
+	} else {
+		out.uv[0] = out.uv[1] = 0;
+	}
+}
+
+#if defined(GFXE_PACK_SSE2)
+
+static inline __m128i select(__m128i mask, __m128i a, __m128i b) {
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Four floats to four halves in the low 64 bits.
+static inline __m128i halfx4(__m128 f) {
+#if defined(__F16C__)
+	return _mm_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT);
+#else
+	const __m128i f16Max = _mm_set1_epi32((127 + 16) << 23);
+	const __m128i denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+
+	__m128i u = _mm_castps_si128(f);
+	const __m128i sign = _mm_and_si128(u, _mm_set1_epi32(i32(0x80000000u)));
+	u = _mm_xor_si128(u, sign);
+
+	// With the sign cleared every value is below 2^31, so signed compares are safe.
+	const __m128i special = _mm_or_si128(_mm_cmpgt_epi32(u, f16Max), _mm_cmpeq_epi32(u, f16Max));
+	const __m128i nan = _mm_cmpgt_epi32(u, _mm_set1_epi32(255 << 23));
+	const __m128i specialBits = select(nan, _mm_set1_epi32(0x7e00), _mm_set1_epi32(0x7c00));
+
+	const __m128i denorm = _mm_cmplt_epi32(u, _mm_set1_epi32(113 << 23));
+	const __m128 denormF = _mm_add_ps(_mm_castsi128_ps(u), _mm_castsi128_ps(denormMagic));
+	const __m128i denormBits = _mm_sub_epi32(_mm_castps_si128(denormF), denormMagic);
+
+	const __m128i mantOdd = _mm_and_si128(_mm_srli_epi32(u, 13), _mm_set1_epi32(1));
+	__m128i normalBits = _mm_add_epi32(u, _mm_set1_epi32(i32(0xC8000FFFu)));
+	normalBits = _mm_srli_epi32(_mm_add_epi32(normalBits, mantOdd), 13);
+
+	__m128i bits = select(special, specialBits, select(denorm, denormBits, normalBits));
+	bits = _mm_or_si128(bits, _mm_srli_epi32(sign, 16));
+
+	// Sign-extend so the saturating pack keeps all 16 bits intact.
+	bits = _mm_srai_epi32(_mm_slli_epi32(bits, 16), 16);
+	return _mm_packs_epi32(bits, bits);
+#endif
+}
+
+static inline __m128i snormx4(__m128 v, f32 scale) {
+	v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+	return _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(scale)));
+}
+
+static inline __m128 signNotZerox4(__m128 v) {
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	return _mm_or_ps(_mm_and_ps(v, signMask), _mm_set1_ps(1.0f));
+}
+
+static inline __m128 absx4(__m128 v) {
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+// Packs vertices [i, i + 4) with the streams transposed to one lane per vertex.
+static void packBlock(const MeshSource& mesh, u32 i, PackedVertex* out) {
+	alignas(16) u16 halves[8];
+	alignas(16) u32 words[4];
+
+	for (u32 j = 0; j < 4; j++) {
+		const f32* p = mesh.positions + (i + j) * 3;
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out[j].position), halfx4(_mm_setr_ps(p[0], p[1], p[2], 1.0f)));
+	}
+
+	if (mesh.uvs) {
+		const f32* uv = mesh.uvs + i * 2;
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(halves), halfx4(_mm_loadu_ps(uv)));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(halves + 4), halfx4(_mm_loadu_ps(uv + 4)));
+		for (u32 j = 0; j < 4; j++) {
+			out[j].uv[0] = halves[j * 2 + 0];
+			out[j].uv[1] = halves[j * 2 + 1];
+		}
+	} else {
+		for (u32 j = 0; j < 4; j++) out[j].uv[0] = out[j].uv[1] = 0;
+	}
+
+	if (mesh.normals) {
+		const f32* n = mesh.normals + i * 3;
+		const __m128 x = _mm_setr_ps(n[0], n[3], n[6], n[9]);
+		const __m128 y = _mm_setr_ps(n[1], n[4], n[7], n[10]);
+		const __m128 z = _mm_setr_ps(n[2], n[5], n[8], n[11]);
+
+		const __m128 l1 = _mm_add_ps(_mm_add_ps(absx4(x), absx4(y)), absx4(z));
+		const __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(l1, _mm_set1_ps(1e-20f)));
+		__m128 px = _mm_mul_ps(x, inv);
+		__m128 py = _mm_mul_ps(y, inv);
+
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 wx = _mm_mul_ps(_mm_sub_ps(one, absx4(py)), signNotZerox4(px));
+		const __m128 wy = _mm_mul_ps(_mm_sub_ps(one, absx4(px)), signNotZerox4(py));
+		const __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+		px = select(lower, wx, px);
+		py = select(lower, wy, py);
+
+		const __m128i ix = _mm_and_si128(snormx4(px, 32767.0f), _mm_set1_epi32(0xffff));
+		const __m128i iy = _mm_slli_epi32(snormx4(py, 32767.0f), 16);
+		_mm_store_si128(reinterpret_cast<__m128i*>(words), _mm_or_si128(ix, iy));
+		for (u32 j = 0; j < 4; j++) std::memcpy(out[j].normal, &words[j], 4);
+	} else {
+		for (u32 j = 0; j < 4; j++) out[j].normal[0] = out[j].normal[1] = 0;
+	}
+
+	if (mesh.tangents) {
+		const f32* t = mesh.tangents + i * 4;
+		__m128 x = _mm_loadu_ps(t), y = _mm_loadu_ps(t + 4);
+		__m128 z = _mm_loadu_ps(t + 8), w = _mm_loadu_ps(t + 12);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+
+		const __m128i tenBits = _mm_set1_epi32(0x3ff);
+		__m128i packed = _mm_and_si128(snormx4(x, 511.0f), tenBits);
+		packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_and_si128(snormx4(y, 511.0f), tenBits), 10));
+		packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_and_si128(snormx4(z, 511.0f), tenBits), 20));
+		packed = _mm_or_si128(packed, _mm_slli_epi32(snormx4(w, 1.0f), 30));
+		_mm_store_si128(reinterpret_cast<__m128i*>(words), packed);
+		for (u32 j = 0; j < 4; j++) out[j].tangent = words[j];
+	} else {
+		const u32 t = packSnorm2101010(1.0f, 0.0f, 0.0f, 1.0f);
+		for (u32 j = 0; j < 4; j++) out[j].tangent = t;
+	}
+}
+
+#endif
+
+void packHalf(const f32* in, u16* out, size_t count) {
+	size_t i = 0;
+#if defined(GFXE_PACK_SSE2)
+	for (; i + 4 <= count; i += 4) {
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), halfx4(_mm_loadu_ps(in + i)));
+	}
+#endif
+	for (; i < count; i++) {
+		out[i] = packHalf(in[i]);
+	}
+}
+
+void packMesh(const MeshSource& mesh, PackedVertex* out) {
+	if (!mesh.positions) {
+		return;
+	}
+
+	u32 i = 0;
+#if defined(GFXE_PACK_SSE2)
+	for (; i + 4 <= mesh.vertexCount; i += 4) {
+		packBlock(mesh, i, out + i);
+	}
+#endif
+	for (; i < mesh.vertexCount; i++) {
+		packVertex(mesh, i, out[i]);
+	}
+}
+
+std::vector<PackedVertex> packMesh(const MeshSource& mesh) {
+	std::vector<PackedVertex> out(mesh.positions ? mesh.vertexCount : 0);
+	packMesh(mesh, out.data());
+	return out;
+}
+
+VertexFormat<sizeof(PackedVertex)> packedFormat() {
+	VertexFormat<sizeof(PackedVertex)> fmt;
+	fmt.add(4, DataType::TypeHalfFloat)
+		.add(2, DataType::TypeShort, true)
+		.add(4, DataType::TypeInt2101010Rev, true)
+		.add(2, DataType::TypeHalfFloat);
+	return fmt;
+}
@@ -0,0 +1,55 @@
+#ifndef GFXE_PACK_H
+#define GFXE_PACK_H
+
+#include <vector>
+
+#include "layout.h"
+
+// Compressed vertex, 20 bytes against 48 for the same attributes as floats.
+struct PackedVertex {
+	u16 position[4]; // half xyz, w = 1
+	i16 normal[2];   // octahedral, snorm16
+	u32 tangent;     // snorm 2_10_10_10_REV, w = bitangent sign
+	u16 uv[2];       // half
+};
+
+using PackedLayout = VertexLayout<
+	Attr<4, DataType::TypeHalfFloat>,
+	Attr<2, DataType::TypeShort, AttrNormalized>,
+	Attr<4, DataType::TypeInt2101010Rev, AttrNormalized>,
+	Attr<2, DataType::TypeHalfFloat>
+>;
+
+static_assert(PackedLayout::describes<PackedVertex>(), "PackedVertex does not match PackedLayout");
+
+// Float streams to pack; everything but positions may be null. Normals and
+// positions are 3 floats per vertex, tangents 4 and uvs 2.
+struct MeshSource {
+	const f32* positions{ nullptr };
+	const f32* normals{ nullptr };
+	const f32* tangents{ nullptr };
+	const f32* uvs{ nullptr };
+	u32 vertexCount{ 0 };
+};
+
+u16 packHalf(f32 v);
+f32 unpackHalf(u16 v);
+
+// Converts count floats to halves, four at a time where SIMD is available.
+void packHalf(const f32* in, u16* out, size_t count);
+
+u32 packSnorm2101010(f32 x, f32 y, f32 z, f32 w);
+
+void packOctahedral(const f32* normal, i16* out);
+void unpackOctahedral(const i16* in, f32* normal);
+
+void packMesh(const MeshSource& mesh, PackedVertex* out);
+std::vector<PackedVertex> packMesh(const MeshSource& mesh);
+
+// Runtime format matching PackedVertex, for code using VertexFormat.
+VertexFormat<sizeof(PackedVertex)> packedFormat();
+
+// GLSL helper turning the normal attribute back into a unit vector.
+extern const char* const OctahedralDecodeGLSL;
+
+#endif // GFXE_PACK_H
@@ -0,0 +1,119 @@
+#include "pipeline.h"
+#include "state.h"
+#include "caps.h"
+#include "hash.h"
+
+#include <algorithm>
+
+ProgramPipeline& ProgramPipeline::create() {
+	if (Caps::directStateAccess()) {
+		glCreateProgramPipelines(1, &m_id);
+	} else {
+		glGenProgramPipelines(1, &m_id);
+	}
+	return *this;
+}
+
+void ProgramPipeline::destroy() {
+	if (m_id) {
+		StateCache::get().forgetProgramPipeline(m_id);
+		glDeleteProgramPipelines(1, &m_id);
+		m_id = 0;
+	}
+	m_attached.clear();
+	m_complete = true;
+}
+
+ProgramPipeline& ProgramPipeline::stages(const Shader& program, u32 bits) {
+	if (!program.isSeparable() || program.status() != Shader::StatusReady) {
+		m_complete = false;
+		return *this;
+	}
+
+	bits = bits ? bits : program.stages();
+	glUseProgramStages(m_id, bits, program.id());
+	m_attached.push_back(Attached{ &program, bits, program.id() });
+	return *this;
+}
+
+ProgramPipeline& ProgramPipeline::bind() {
+	for (auto&& stage : m_attached) {
+		const Shader& program = *stage.program;
+		if (program.id() != stage.id && program.status() == Shader::StatusReady) {
+			glUseProgramStages(m_id, stage.bits, program.id());
+			stage.id = program.id();
+		}
+		program.flush();
+	}
+
+	// A program in use takes precedence over the bound pipeline.
+	StateCache& cache = StateCache::get();
+	cache.useProgram(0);
+	cache.bindProgramPipeline(m_id);
+	return *this;
+}
+
+bool ProgramPipeline::validate() {
+	glValidateProgramPipeline(m_id);
+
+	GLint valid = GL_FALSE;
+	glGetProgramPipelineiv(m_id, GL_VALIDATE_STATUS, &valid);
+
+	m_infoLog.clear();
+	GLint length = 0;
+	glGetProgramPipelineiv(m_id, GL_INFO_LOG_LENGTH, &length);
+	if (length > 1) {
+		std::vector<char> log(length);
+		glGetProgramPipelineInfoLog(m_id, length, &length, log.data());
+		m_infoLog.assign(log.data(), length);
+	}
+	return valid == GL_TRUE;
+}
+
+void PipelineCache::destroy() {
+	for (auto&& [key, entry] : m_pipelines) {
+		entry.pipeline.destroy();
+	}
+	m_pipelines.clear();
+}
+
+ProgramPipeline& PipelineCache::get(std::initializer_list<Shader*> programs) {
+	std::vector<const Shader*> key(programs.begin(), programs.end());
+	const u64 hash = hashBytes(key.data(), key.size() * sizeof(const Shader*));
+
+	auto pos = m_pipelines.find(hash);
+	if (pos != m_pipelines.end() && pos->second.programs == key) {
+		return pos->second.pipeline;
+	}
+
+	ProgramPipeline pipeline;
+	pipeline.create();
+	for (Shader* program : programs) {
+		pipeline.stages(program->wait());
+	}
+	if (!pipeline.complete()) {
+		pipeline.destroy();
+		return m_empty;
+	}
+
+	if (pos != m_pipelines.end()) {
+		// Hash collision: the newer combination takes the slot.
+		pos->second.pipeline.destroy();
+	}
+	Entry& entry = m_pipelines[hash];
+	entry.programs = std::move(key);
+	entry.pipeline = pipeline;
+	return entry.pipeline;
+}
+
+void PipelineCache::forget(const Shader& program) {
+	for (auto it = m_pipelines.begin(); it != m_pipelines.end();) {
+		auto& list = it->second.programs;
+		if (std::find(list.begin(), list.end(), &program) != list.end()) {
+			it->second.pipeline.destroy();
+			it = m_pipelines.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
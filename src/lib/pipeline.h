@@ -0,0 +1,86 @@
+#ifndef GFXE_PIPELINE_H
+#define GFXE_PIPELINE_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <initializer_list>
+
+#include "shader.h"
+
+// Stages from separable programs, combined at bind time. Each stage is
+// linked once, so a vertex program can pair with any fragment program
+// without linking the combination.
+//
+// glUniform* targets the bound program, which a pipeline doesn't have: set
+// uniforms through Shader::set, which flushes with glProgramUniform*.
+class ProgramPipeline {
+public:
+	ProgramPipeline() = default;
+	~ProgramPipeline() = default;
+
+	ProgramPipeline& create();
+	void destroy();
+
+	// Takes `bits` (GL_*_SHADER_BIT) from a linked separable program, or
+	// every stage it has by default. Programs that aren't ready or separable
+	// are skipped; see complete().
+	ProgramPipeline& stages(const Shader& program, u32 bits = 0);
+
+	// Flushes each program's uniforms, then binds the pipeline in place of
+	// any program. Stages whose program was replaced since (hot reload) are
+	// re-attached from the new program first.
+	ProgramPipeline& bind();
+
+	// Whether every program passed to stages() was attached.
+	bool complete() const { return m_complete; }
+
+	// Checks that the stage interfaces match; the reason is in infoLog().
+	bool validate();
+	const std::string& infoLog() const { return m_infoLog; }
+
+	GLuint id() const { return m_id; }
+
+private:
+	struct Attached {
+		const Shader* program;
+		u32 bits;
+		GLuint id; // program id when attached
+	};
+
+	GLuint m_id{ 0 };
+	std::vector<Attached> m_attached;
+	bool m_complete{ true };
+	std::string m_infoLog;
+};
+
+// Pipelines keyed by the Shader objects supplying their stages, so each
+// combination is set up once and follows its programs through replace().
+class PipelineCache {
+public:
+	PipelineCache() = default;
+	~PipelineCache() = default;
+
+	void destroy();
+
+	// Waits for pending programs. A combination that can't be fully
+	// attached (a failed or non-separable program) is not cached, and an
+	// empty pipeline is returned.
+	ProgramPipeline& get(std::initializer_list<Shader*> programs);
+
+	// Drops the pipelines that use a program, e.g. before it is destroyed.
+	void forget(const Shader& program);
+
+	u32 size() const { return u32(m_pipelines.size()); }
+
+private:
+	struct Entry {
+		std::vector<const Shader*> programs;
+		ProgramPipeline pipeline;
+	};
+
+	std::unordered_map<u64, Entry> m_pipelines;
+	ProgramPipeline m_empty;
+};
+
+#endif // GFXE_PIPELINE_H
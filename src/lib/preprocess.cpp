@@ -0,0 +1,319 @@
+#include "preprocess.h"
+#include "hash.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+static std::string normalize(const fs::path& path) {
+	return path.lexically_normal().generic_string();
+}
+
+static size_t skipSpace(const std::string& s, size_t at) {
+	while (at < s.size() && (s[at] == ' ' || s[at] == '\t')) at++;
+	return at;
+}
+
+// Matches `word` after a '#' at the start of a line, returning the position
+// just past it, or npos.
+static size_t directive(const std::string& line, const char* word) {
+	size_t at = skipSpace(line, 0);
+	if (at >= line.size() || line[at] != '#') return std::string::npos;
+	at = skipSpace(line, at + 1);
+
+	const size_t len = std::char_traits<char>::length(word);
+	if (line.compare(at, len, word) != 0) return std::string::npos;
+	const size_t end = at + len;
+	if (end < line.size() && line[end] != ' ' && line[end] != '\t' && line[end] != '"' && line[end] != '<') {
+		return std::string::npos;
+	}
+	return end;
+}
+
+ShaderPreprocessor& ShaderPreprocessor::includePath(const std::string& dir) {
+	m_includePaths.push_back(normalize(dir));
+	m_built.clear();
+	return *this;
+}
+
+ShaderPreprocessor& ShaderPreprocessor::source(const std::string& name, const std::string& text) {
+	File& file = m_files[normalize(name)];
+	file.inMemory = true;
+	file.hash = hashString(text);
+	parse(text, file.hash);
+	return *this;
+}
+
+ShaderPreprocessor& ShaderPreprocessor::lineDirectives(bool enabled) {
+	if (m_lines != enabled) {
+		m_lines = enabled;
+		m_built.clear();
+	}
+	return *this;
+}
+
+void ShaderPreprocessor::clear() {
+	m_files.clear();
+	m_parsed.clear();
+	m_includes.clear();
+	m_built.clear();
+}
+
+std::vector<std::string> ShaderPreprocessor::candidates(const std::string& name, const std::string& fromDir) const {
+	std::vector<std::string> result;
+	result.push_back(normalize(fs::path(fromDir) / name));
+	for (auto&& dir : m_includePaths) {
+		result.push_back(normalize(fs::path(dir) / name));
+	}
+	return result;
+}
+
+bool ShaderPreprocessor::exists(const std::string& path) const {
+	auto pos = m_files.find(path);
+	if (pos != m_files.end() && pos->second.inMemory) return true;
+
+	std::error_code ec;
+	return fs::is_regular_file(path, ec);
+}
+
+std::string ShaderPreprocessor::resolve(const std::string& name, const std::string& fromDir) const {
+	for (auto&& path : candidates(name, fromDir)) {
+		if (exists(path)) return path;
+	}
+	return "";
+}
+
+// resolve(), remembering the lookup and every path tried before the answer.
+std::string ShaderPreprocessor::lookup(const std::string& name, const std::string& fromDir, Expansion& e) const {
+	std::string found;
+	auto& probes = e.output.probes;
+	for (auto&& path : candidates(name, fromDir)) {
+		if (exists(path)) {
+			found = path;
+			break;
+		}
+		if (std::find(probes.begin(), probes.end(), path) == probes.end()) {
+			probes.push_back(path);
+		}
+	}
+	e.lookups.push_back(Lookup{ name, fromDir, found });
+	return found;
+}
+
+const ShaderPreprocessor::File* ShaderPreprocessor::refresh(const std::string& path) {
+	auto pos = m_files.find(path);
+	if (pos != m_files.end() && pos->second.inMemory) {
+		return &pos->second;
+	}
+
+	std::error_code ec;
+	const auto time = fs::last_write_time(path, ec);
+	if (ec) {
+		if (pos != m_files.end()) m_files.erase(pos);
+		return nullptr;
+	}
+	if (pos != m_files.end() && pos->second.time == time) {
+		return &pos->second;
+	}
+
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		return nullptr;
+	}
+	std::stringstream text;
+	text << in.rdbuf();
+
+	File& file = m_files[path];
+	file.time = time;
+	file.hash = hashString(text.str());
+	parse(text.str(), file.hash);
+	return &file;
+}
+
+void ShaderPreprocessor::parse(const std::string& text, u64 hash) {
+	if (m_parsed.find(hash) != m_parsed.end()) {
+		return;
+	}
+
+	Parsed& parsed = m_parsed[hash];
+	Chunk* current = nullptr;
+
+	std::istringstream in(text);
+	std::string line;
+	for (u32 number = 1; std::getline(in, line); number++) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+
+		size_t at;
+		if ((at = directive(line, "include")) != std::string::npos) {
+			at = skipSpace(line, at);
+			const char close = (at < line.size() && line[at] == '<') ? '>' : '"';
+			const size_t end = line.find(close, at + 1);
+			if (at < line.size() && end != std::string::npos) {
+				parsed.chunks.push_back(Chunk{ Chunk::Include, line.substr(at + 1, end - at - 1), number });
+				current = nullptr;
+				continue;
+			}
+		} else if (directive(line, "version") != std::string::npos) {
+			parsed.chunks.push_back(Chunk{ Chunk::Version, line + "\n", number });
+			parsed.hasVersion = true;
+			current = nullptr;
+			continue;
+		} else if ((at = directive(line, "pragma")) != std::string::npos) {
+			at = skipSpace(line, at);
+			if (line.compare(at, 4, "once") == 0) {
+				parsed.once = true;
+				current = nullptr;
+				continue;
+			}
+		}
+
+		if (!current) {
+			parsed.chunks.push_back(Chunk{ Chunk::Text, "", number });
+			current = &parsed.chunks.back();
+		}
+		current->text += line;
+		current->text += '\n';
+	}
+}
+
+void ShaderPreprocessor::expand(const std::string& path, Expansion& e) {
+	if (std::find(e.stack.begin(), e.stack.end(), path) != e.stack.end()) {
+		return;
+	}
+
+	const File* file = refresh(path);
+	if (!file) {
+		return;
+	}
+	const u64 hash = file->hash;
+	const Parsed& parsed = m_parsed[hash];
+	if (parsed.once && !e.once.insert(path).second) {
+		return;
+	}
+
+	auto& files = e.output.files;
+	auto known = std::find(files.begin(), files.end(), path);
+	const u32 id = u32(known - files.begin());
+	if (known == files.end()) files.push_back(path);
+
+	e.stamps.emplace_back(path, hash);
+	e.stack.push_back(path);
+
+	const bool root = e.stack.size() == 1;
+	const std::string dir = normalize(fs::path(path).parent_path());
+
+	// Nothing but comments may come before #version.
+	bool versionSeen = !(root && parsed.hasVersion);
+
+	std::vector<std::string> edges;
+	for (auto&& chunk : parsed.chunks) {
+		switch (chunk.kind) {
+			case Chunk::Version:
+				// Only the root file's #version survives.
+				if (root) {
+					e.output.source += chunk.text;
+					versionSeen = true;
+				}
+				break;
+			case Chunk::Text:
+				if (m_lines && versionSeen) {
+					e.output.source += "#line " + std::to_string(chunk.line) + " " + std::to_string(id) + "\n";
+				}
+				e.output.source += chunk.text;
+				break;
+			case Chunk::Include: {
+				const std::string target = lookup(chunk.text, dir, e);
+				if (target.empty()) {
+					e.output.source += "#error cannot find include \"" + chunk.text + "\"\n";
+					break;
+				}
+				edges.push_back(target);
+				expand(target, e);
+			} break;
+		}
+	}
+
+	m_includes[path] = std::move(edges);
+	e.stack.pop_back();
+}
+
+const ShaderPreprocessor::Output& ShaderPreprocessor::build(const std::string& path) {
+	Expansion e;
+	const std::string root = lookup(path, "", e);
+
+	// Keyed by the name asked for, so names that resolve to nothing don't share.
+	const std::string key = normalize(path);
+	auto pos = m_built.find(key);
+	if (pos != m_built.end()) {
+		bool fresh = true;
+		for (auto&& [file, hash] : pos->second.stamps) {
+			const File* f = refresh(file);
+			if (!f || f->hash != hash) {
+				fresh = false;
+				break;
+			}
+		}
+		// A missing include may have appeared, or a new file may now shadow one.
+		for (auto&& l : pos->second.lookups) {
+			if (!fresh) break;
+			fresh = resolve(l.name, l.fromDir) == l.resolved;
+		}
+		if (fresh) {
+			return pos->second.output;
+		}
+	}
+
+	if (!root.empty()) {
+		expand(root, e);
+	}
+	e.output.hash = hashString(e.output.source);
+
+	Built& built = m_built[key];
+	built.stamps = std::move(e.stamps);
+	built.lookups = std::move(e.lookups);
+	built.output = std::move(e.output);
+	return built.output;
+}
+
+std::vector<std::string> ShaderPreprocessor::dependencies(const std::string& path) const {
+	std::vector<std::string> result;
+	std::vector<std::string> open{ normalize(path) };
+	std::unordered_set<std::string> seen(open.begin(), open.end());
+
+	while (!open.empty()) {
+		const std::string file = open.back();
+		open.pop_back();
+
+		auto pos = m_includes.find(file);
+		if (pos == m_includes.end()) continue;
+		for (auto&& dep : pos->second) {
+			if (seen.insert(dep).second) {
+				result.push_back(dep);
+				open.push_back(dep);
+			}
+		}
+	}
+	return result;
+}
+
+std::vector<std::string> ShaderPreprocessor::dependents(const std::string& path) const {
+	std::vector<std::string> result;
+	std::vector<std::string> open{ normalize(path) };
+	std::unordered_set<std::string> seen(open.begin(), open.end());
+
+	while (!open.empty()) {
+		const std::string file = open.back();
+		open.pop_back();
+
+		for (auto&& [includer, edges] : m_includes) {
+			if (std::find(edges.begin(), edges.end(), file) == edges.end()) continue;
+			if (seen.insert(includer).second) {
+				result.push_back(includer);
+				open.push_back(includer);
+			}
+		}
+	}
+	return result;
+}
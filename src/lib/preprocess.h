@@ -0,0 +1,122 @@
+#ifndef GFXE_PREPROCESS_H
+#define GFXE_PREPROCESS_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "integer.h"
+
+// Expands #include "file" and #include <file> in GLSL sources. Includes
+// resolve against the including file's directory, then the include paths.
+// #pragma once is honored and cycles are cut.
+//
+// Files are parsed once per distinct content: a file is only re-read when
+// its modification time changes, and only re-parsed when its content hash
+// does. A build whose files are all unchanged, and whose includes all still
+// resolve to the same files, returns the previous result.
+class ShaderPreprocessor {
+public:
+	struct Output {
+		std::string source;
+		u64 hash{ 0 }; // of source
+
+		// Every file that went into source. With line directives, a
+		// "#line N i" refers to files[i].
+		std::vector<std::string> files;
+
+		// Paths that were looked for and not found, ahead of or instead of
+		// an include. A file appearing at one of them changes the output.
+		std::vector<std::string> probes;
+	};
+
+	ShaderPreprocessor() = default;
+	~ShaderPreprocessor() = default;
+
+	ShaderPreprocessor& includePath(const std::string& dir);
+
+	// An in-memory file, found by name before anything on disk.
+	ShaderPreprocessor& source(const std::string& name, const std::string& text);
+
+	// Emits #line directives so compiler errors point at the original files.
+	ShaderPreprocessor& lineDirectives(bool enabled);
+
+	// An empty source means the file wasn't found. Includes that can't be
+	// found become #error lines, so compiling reports them.
+	const Output& build(const std::string& path);
+
+	// Resolved path of a file as build() would find it; empty if none.
+	std::string resolve(const std::string& name, const std::string& fromDir = "") const;
+
+	// Files a file includes, directly or not, as of its last build.
+	std::vector<std::string> dependencies(const std::string& path) const;
+
+	// Files that include a file, directly or not.
+	std::vector<std::string> dependents(const std::string& path) const;
+
+	void clear();
+
+private:
+	struct Chunk {
+		enum Kind {
+			Text,
+			Include,
+			Version
+		};
+
+		Kind kind;
+		std::string text; // the include name for Include
+		u32 line;
+	};
+
+	struct Parsed {
+		std::vector<Chunk> chunks;
+		bool once{ false };
+		bool hasVersion{ false };
+	};
+
+	struct File {
+		std::filesystem::file_time_type time;
+		u64 hash{ 0 };
+		bool inMemory{ false };
+	};
+
+	struct Lookup {
+		std::string name, fromDir;
+		std::string resolved; // empty if nothing was found
+	};
+
+	struct Built {
+		std::vector<std::pair<std::string, u64>> stamps;
+		std::vector<Lookup> lookups;
+		Output output;
+	};
+
+	struct Expansion {
+		Output output;
+		std::vector<std::pair<std::string, u64>> stamps;
+		std::vector<Lookup> lookups;
+		std::vector<std::string> stack;
+		std::unordered_set<std::string> once;
+	};
+
+	std::vector<std::string> m_includePaths;
+	bool m_lines{ false };
+
+	std::unordered_map<std::string, File> m_files;    // by resolved path
+	std::unordered_map<u64, Parsed> m_parsed;         // by content hash
+	std::unordered_map<std::string, std::vector<std::string>> m_includes; // direct edges
+	std::unordered_map<std::string, Built> m_built;   // by requested path
+
+	std::vector<std::string> candidates(const std::string& name, const std::string& fromDir) const;
+	bool exists(const std::string& path) const;
+	std::string lookup(const std::string& name, const std::string& fromDir, Expansion& e) const;
+
+	const File* refresh(const std::string& path);
+	void parse(const std::string& text, u64 hash);
+	void expand(const std::string& path, Expansion& e);
+};
+
+#endif // GFXE_PREPROCESS_H
@@ -0,0 +1,129 @@
+#include "progcache.h"
+#include "hash.h"
+
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
+
+static const u32 CacheMagic = 0x50584647; // "GFXP"
+static const u32 CacheVersion = 1;
+
+struct CacheHeader {
+	u32 magic;
+	u32 version;
+	u64 key;
+	u32 format;
+	u32 length;
+};
+
+static std::string glString(GLenum name) {
+	const GLubyte* str = glGetString(name);
+	return str ? reinterpret_cast<const char*>(str) : "";
+}
+
+ProgramCache& ProgramCache::create(const std::string& directory) {
+	m_directory = directory;
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	m_enabled = formats > 0;
+
+	std::error_code ec;
+	std::filesystem::create_directories(m_directory, ec);
+	if (ec) {
+		m_enabled = false;
+	}
+
+	u64 hash = hashString(glString(GL_VENDOR));
+	hash = hashString(glString(GL_RENDERER), hash);
+	hash = hashString(glString(GL_VERSION), hash);
+	hash = hashString(glString(GL_SHADING_LANGUAGE_VERSION), hash);
+	m_driverHash = hash;
+
+	return *this;
+}
+
+std::string ProgramCache::path(u64 key) const {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+	return (std::filesystem::path(m_directory) / name).string();
+}
+
+bool ProgramCache::load(u64 key, GLuint program) {
+	if (!m_enabled) {
+		return false;
+	}
+
+	const std::string file = path(key);
+	std::ifstream in(file, std::ios::binary);
+	if (!in) {
+		return false;
+	}
+
+	CacheHeader header;
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		return false;
+	}
+	if (header.magic != CacheMagic || header.version != CacheVersion || header.key != key) {
+		return false;
+	}
+
+	// The length comes from disk: check it against what is actually there
+	// before allocating, and drop entries that don't add up.
+	std::error_code ec;
+	const u64 fileSize = std::filesystem::file_size(file, ec);
+	if (ec || header.length == 0 || u64(header.length) != fileSize - sizeof(header)) {
+		in.close();
+		std::filesystem::remove(file, ec);
+		return false;
+	}
+
+	std::vector<char> binary(header.length);
+	if (!in.read(binary.data(), header.length)) {
+		return false;
+	}
+
+	glProgramBinary(program, header.format, binary.data(), header.length);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	return linked == GL_TRUE;
+}
+
+void ProgramCache::store(u64 key, GLuint program) {
+	if (!m_enabled) {
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+	CacheHeader header;
+	header.magic = CacheMagic;
+	header.version = CacheVersion;
+	header.key = key;
+	header.format = format;
+	header.length = u32(length);
+
+	// Write then rename, so a crash never leaves a truncated entry behind.
+	const std::string target = path(key);
+	const std::string temp = target + ".tmp";
+	{
+		std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+		if (!out) return;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(binary.data(), length);
+		if (!out) return;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp, target, ec);
+}
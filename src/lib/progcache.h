@@ -0,0 +1,39 @@
+#ifndef GFXE_PROGCACHE_H
+#define GFXE_PROGCACHE_H
+
+#include <string>
+
+#include "glad/glad.h"
+#include "integer.h"
+
+// On-disk cache of linked program binaries. Keys mix the program's sources
+// and defines with the driver's vendor, renderer and version strings, so a
+// driver update or an edited shader simply misses and gets rebuilt.
+class ProgramCache {
+public:
+	ProgramCache() = default;
+	~ProgramCache() = default;
+
+	// Disabled when the driver exposes no binary formats.
+	ProgramCache& create(const std::string& directory);
+
+	// Seed for program keys: the driver identity, computed once.
+	u64 driverHash() const { return m_driverHash; }
+
+	// Loads a binary into program; false when missing, stale or rejected.
+	bool load(u64 key, GLuint program);
+
+	// Writes a successfully linked program's binary.
+	void store(u64 key, GLuint program);
+
+	bool enabled() const { return m_enabled; }
+
+private:
+	std::string m_directory;
+	u64 m_driverHash{ 0 };
+	bool m_enabled{ false };
+
+	std::string path(u64 key) const;
+};
+
+#endif // GFXE_PROGCACHE_H
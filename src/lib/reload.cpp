@@ -0,0 +1,237 @@
+#include "reload.h"
+#include "hash.h"
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+ShaderReloader& ShaderReloader::create(ShaderPreprocessor& preprocessor) {
+	m_preprocessor = &preprocessor;
+#if defined(__linux__)
+	m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+	return *this;
+}
+
+void ShaderReloader::destroy() {
+	for (auto&& entry : m_entries) {
+		if (entry.pending) entry.next.destroy();
+	}
+	m_entries.clear();
+	m_dependents.clear();
+#if defined(__linux__)
+	if (m_fd >= 0) close(m_fd);
+	m_fd = -1;
+	m_watches.clear();
+	m_directories.clear();
+#else
+	m_times.clear();
+#endif
+}
+
+u64 ShaderReloader::preprocess(const Entry& entry, std::vector<std::string>& sources) {
+	sources.clear();
+	u64 hash = FnvOffset;
+	for (auto&& stage : entry.stages) {
+		const ShaderPreprocessor::Output& out = m_preprocessor->build(stage.path);
+		sources.push_back(out.source);
+		hash = hashBytes(&out.hash, sizeof(out.hash), hash);
+	}
+	return hash;
+}
+
+void ShaderReloader::start(const Entry& entry, Shader& target, const std::vector<std::string>& sources) {
+	target.create();
+	if (&target != entry.shader) {
+		target.separable(entry.shader->isSeparable());
+		for (auto&& [name, value] : entry.shader->defines()) {
+			target.define(name, value);
+		}
+	}
+	for (size_t i = 0; i < sources.size(); i++) {
+		target.add(sources[i], entry.stages[i].type);
+	}
+	target.link();
+}
+
+void ShaderReloader::track(Entry& entry) {
+	entry.files.clear();
+	for (auto&& stage : entry.stages) {
+		// Watch where missing or shadowable includes could appear, too.
+		for (auto&& probe : m_preprocessor->build(stage.path).probes) {
+			entry.files.push_back(probe);
+		}
+
+		const std::string root = m_preprocessor->resolve(stage.path);
+		if (root.empty()) continue;
+		entry.files.push_back(root);
+		for (auto&& dep : m_preprocessor->dependencies(root)) {
+			entry.files.push_back(dep);
+		}
+	}
+}
+
+void ShaderReloader::rebuildDependents() {
+	m_dependents.clear();
+	for (u32 i = 0; i < m_entries.size(); i++) {
+		for (auto&& file : m_entries[i].files) {
+			auto& list = m_dependents[file];
+			if (list.empty() || list.back() != i) list.push_back(i);
+		}
+	}
+
+	for (auto&& [file, list] : m_dependents) {
+#if defined(__linux__)
+		// Watch directories rather than files: editors often save by
+		// replacing the file, which would drop a per-file watch.
+		if (m_fd < 0) break;
+		fs::path dir = fs::path(file).parent_path();
+		const std::string key = dir.empty() ? "." : dir.generic_string();
+		if (m_directories.find(key) != m_directories.end()) continue;
+
+		const int wd = inotify_add_watch(m_fd, key.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd < 0) continue;
+		m_directories[key] = wd;
+		m_watches[wd] = key;
+#else
+		if (m_times.find(file) != m_times.end()) continue;
+		std::error_code ec;
+		m_times[file] = fs::last_write_time(file, ec);
+#endif
+	}
+}
+
+std::vector<std::string> ShaderReloader::changes() {
+	std::vector<std::string> files;
+#if defined(__linux__)
+	if (m_fd < 0) {
+		return files;
+	}
+
+	alignas(inotify_event) char buffer[4096];
+	for (;;) {
+		const ssize_t length = read(m_fd, buffer, sizeof(buffer));
+		if (length <= 0) break;
+
+		for (ssize_t at = 0; at < length;) {
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + at);
+			at += sizeof(inotify_event) + event->len;
+
+			auto pos = m_watches.find(event->wd);
+			if (pos == m_watches.end() || event->len == 0) continue;
+			files.push_back((fs::path(pos->second) / event->name).lexically_normal().generic_string());
+		}
+	}
+#else
+	for (auto&& [file, time] : m_times) {
+		std::error_code ec;
+		const auto now = fs::last_write_time(file, ec);
+		if (!ec && now != time) {
+			time = now;
+			files.push_back(file);
+		}
+	}
+#endif
+	return files;
+}
+
+ShaderReloader& ShaderReloader::watch(Shader& shader, const std::vector<Stage>& stages) {
+	if (!m_preprocessor) {
+		return *this;
+	}
+
+	Entry entry;
+	entry.shader = &shader;
+	entry.stages = stages;
+
+	std::vector<std::string> sources;
+	entry.sourceHash = preprocess(entry, sources);
+	if (shader.id() == 0) {
+		start(entry, shader, sources);
+	}
+	track(entry);
+
+	m_entries.push_back(std::move(entry));
+	rebuildDependents();
+	return *this;
+}
+
+ShaderReloader& ShaderReloader::unwatch(Shader& shader) {
+	auto pos = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& e) {
+		return e.shader == &shader;
+	});
+	if (pos == m_entries.end()) {
+		return *this;
+	}
+	if (pos->pending) pos->next.destroy();
+	m_entries.erase(pos);
+	rebuildDependents();
+	return *this;
+}
+
+u32 ShaderReloader::update() {
+	std::vector<bool> affected(m_entries.size(), false);
+	for (auto&& file : changes()) {
+		auto pos = m_dependents.find(file);
+		if (pos == m_dependents.end()) continue;
+		for (u32 i : pos->second) affected[i] = true;
+	}
+
+	bool retrack = false;
+	std::vector<std::string> sources;
+	for (u32 i = 0; i < m_entries.size(); i++) {
+		if (!affected[i]) continue;
+		Entry& entry = m_entries[i];
+
+		// Saved without changes, or changed back before a rebuild finished.
+		const u64 hash = preprocess(entry, sources);
+		if (hash == (entry.pending ? entry.nextHash : entry.sourceHash)) continue;
+
+		if (entry.pending) {
+			entry.next.destroy();
+			entry.next = Shader{};
+		}
+		start(entry, entry.next, sources);
+		entry.nextHash = hash;
+		entry.pending = true;
+
+		// The set of includes may have changed too.
+		track(entry);
+		retrack = true;
+	}
+	if (retrack) {
+		rebuildDependents();
+	}
+
+	u32 swapped = 0;
+	for (auto&& entry : m_entries) {
+		if (!entry.pending) continue;
+
+		if (entry.next.ready()) {
+			entry.shader->replace(entry.next);
+			entry.sourceHash = entry.nextHash;
+			entry.error.clear();
+			entry.pending = false;
+			swapped++;
+		} else if (entry.next.status() == Shader::StatusFailed) {
+			entry.error = entry.next.infoLog();
+			entry.next.destroy();
+			entry.next = Shader{};
+			entry.pending = false;
+		}
+	}
+	return swapped;
+}
+
+const std::string& ShaderReloader::error(const Shader& shader) const {
+	static const std::string none;
+	for (auto&& entry : m_entries) {
+		if (entry.shader == &shader) return entry.error;
+	}
+	return none;
+}
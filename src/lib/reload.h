@@ -0,0 +1,78 @@
+#ifndef GFXE_RELOAD_H
+#define GFXE_RELOAD_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "shader.h"
+#include "preprocess.h"
+
+// Development-time shader reloading. Programs are registered together with
+// their stage files; when any of those files or anything they include
+// changes on disk, only the affected programs are rebuilt. Rebuilds link in
+// the background and are swapped in with Shader::replace once they
+// succeed. A failed rebuild leaves the running program in place.
+//
+// Uses inotify on Linux and polls modification times elsewhere.
+class ShaderReloader {
+public:
+	struct Stage {
+		std::string path;
+		Shader::ShaderType type;
+	};
+
+	ShaderReloader() = default;
+	~ShaderReloader() = default;
+
+	ShaderReloader& create(ShaderPreprocessor& preprocessor);
+	void destroy();
+
+	// The shader must stay at the same address while watched. If it has no
+	// program yet, one is built from the stages right away.
+	ShaderReloader& watch(Shader& shader, const std::vector<Stage>& stages);
+	ShaderReloader& unwatch(Shader& shader);
+
+	// Call once per frame: picks up file changes, starts rebuilds and
+	// swaps in the ones that have finished. Returns the number swapped;
+	// each swapped shader's generation() changes.
+	u32 update();
+
+	// Link log of the last failed rebuild of a shader.
+	const std::string& error(const Shader& shader) const;
+
+private:
+	struct Entry {
+		Shader* shader;
+		std::vector<Stage> stages;
+		std::vector<std::string> files;
+		u64 sourceHash{ 0 };
+
+		Shader next;
+		u64 nextHash{ 0 };
+		bool pending{ false };
+		std::string error;
+	};
+
+	ShaderPreprocessor* m_preprocessor{ nullptr };
+	std::vector<Entry> m_entries;
+
+	// Which entries each file feeds into.
+	std::unordered_map<std::string, std::vector<u32>> m_dependents;
+
+#if defined(__linux__)
+	int m_fd{ -1 };
+	std::unordered_map<int, std::string> m_watches; // descriptor -> directory
+	std::unordered_map<std::string, int> m_directories;
+#else
+	std::unordered_map<std::string, std::filesystem::file_time_type> m_times;
+#endif
+
+	u64 preprocess(const Entry& entry, std::vector<std::string>& sources);
+	void start(const Entry& entry, Shader& target, const std::vector<std::string>& sources);
+	void track(Entry& entry);
+	void rebuildDependents();
+	std::vector<std::string> changes();
+};
+
+#endif // GFXE_RELOAD_H
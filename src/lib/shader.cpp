@@ -1,11 +1,37 @@
 #include "shader.h"
+#include "state.h"
+#include "progcache.h"
+#include "hash.h"
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static u32 bitScanForward64(u64 v) {
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward64(&i, v);
+	return u32(i);
+#else
+	return u32(__builtin_ctzll(v));
+#endif
+}
 
 void Shader::destroy() {
 	if (m_id) {
 		unbind();
+		for (auto&& [type, shader] : m_subShaders) {
+			glDeleteShader(shader);
+		}
+		m_subShaders.clear();
+		m_sharedStages.clear();
+		StateCache::get().forgetProgram(m_id);
 		glDeleteProgram(m_id);
 		std::cout << "DEL SHADER" << std::endl;
 	}
@@ -17,58 +43,678 @@ Shader& Shader::create() {
 }
 
 Shader& Shader::bind() {
-	glUseProgram(m_id);
+	// Without a fallback there is nothing else to draw with, so block.
+	if (m_status == StatusPending) {
+		if (m_fallback) ready();
+		else resolve();
+	}
+	flush();
+	StateCache::get().useProgram(activeId());
 	return *this;
 }
 
 Shader& Shader::unbind() {
-	glUseProgram(0);
+	StateCache::get().useProgram(0);
 	return *this;
 }
 
+Shader& Shader::cache(ProgramCache& cache) {
+	m_cache = &cache;
+	return *this;
+}
+
+Shader& Shader::define(const std::string& name, const std::string& value) {
+	m_defines[name] = value;
+	return *this;
+}
+
+std::string Shader::applyDefines(const std::string& source) const {
+	return injectDefines(source, m_defines);
+}
+
+std::string Shader::injectDefines(const std::string& source, const DefineMap& defines) {
+	if (defines.empty()) {
+		return source;
+	}
+
+	std::string block;
+	for (auto&& [name, value] : defines) {
+		block += "#define " + name + " " + value + "\n";
+	}
+
+	size_t at = source.find("#version");
+	if (at == std::string::npos) {
+		return block + source;
+	}
+	at = source.find('\n', at);
+	at = (at == std::string::npos) ? source.size() : at + 1;
+	return source.substr(0, at) + block + source.substr(at);
+}
+
+static u32 stageBit(Shader::ShaderType type) {
+	switch (type) {
+		case Shader::VertexShader: return GL_VERTEX_SHADER_BIT;
+		case Shader::FragmentShader: return GL_FRAGMENT_SHADER_BIT;
+		case Shader::GeometryShader: return GL_GEOMETRY_SHADER_BIT;
+		case Shader::ComputeShader: return GL_COMPUTE_SHADER_BIT;
+	}
+	return 0;
+}
+
 Shader& Shader::add(const std::string& source, Shader::ShaderType type) {
 	if (m_subShaders.find(type) != m_subShaders.end()) {
 		return *this;
 	}
+	m_stages |= stageBit(type);
 
+	if (m_cache && m_cache->enabled()) {
+		for (auto&& [t, src] : m_sources) {
+			if (t == type) return *this;
+		}
+		m_sources.emplace_back(type, applyDefines(source));
+		return *this;
+	}
+
+	compile(applyDefines(source), type);
+	return *this;
+}
+
+void Shader::compile(const std::string& source, Shader::ShaderType type) {
 	GLuint s = glCreateShader(GLenum(type));
 
 	const char* src = source.c_str();
 	glShaderSource(s, 1, &src, nullptr);
 	glCompileShader(s);
 
-	GLint isCompiled = 0;
-	glGetShaderiv(s, GL_COMPILE_STATUS, &isCompiled);
-	if (isCompiled == GL_FALSE) {
-		i32 maxLength = 0;
-		glGetShaderiv(s, GL_INFO_LOG_LENGTH, &maxLength);
-
-		std::vector<char> infoLog(maxLength);
-		glGetShaderInfoLog(s, maxLength, &maxLength, &infoLog[0]);
-
-		glDeleteShader(s);
+	glAttachShader(m_id, s);
+	m_subShaders[type] = s;
+}
 
+Shader& Shader::attach(GLuint stage, Shader::ShaderType type) {
+	if (m_subShaders.find(type) != m_subShaders.end() || m_sharedStages.find(type) != m_sharedStages.end()) {
 		return *this;
 	}
+	glAttachShader(m_id, stage);
+	m_sharedStages[type] = stage;
+	m_stages |= stageBit(type);
+	return *this;
+}
 
-	glAttachShader(m_id, s);
-	m_subShaders[type] = s;
-
+Shader& Shader::separable(bool enabled) {
+	m_separable = enabled;
 	return *this;
 }
 
 Shader& Shader::link() {
+	// Also set before loading a cached binary; the flag is part of its key.
+	glProgramParameteri(m_id, GL_PROGRAM_SEPARABLE, m_separable ? GL_TRUE : GL_FALSE);
+
+	m_cacheKey = 0;
+	if (!m_sources.empty() && !m_sharedStages.empty()) {
+		// A binary linked against one shared stage can't stand in for another.
+		for (auto&& [type, source] : m_sources) {
+			compile(source, type);
+		}
+		m_sources.clear();
+	} else if (!m_sources.empty()) {
+		u64 key = m_cache->driverHash();
+		key = hashBytes(&m_separable, sizeof(m_separable), key);
+		for (auto&& [type, source] : m_sources) {
+			const u32 t = u32(type);
+			key = hashBytes(&t, sizeof(t), key);
+			key = hashString(source, key);
+		}
+
+		if (m_cache->load(key, m_id)) {
+			m_sources.clear();
+			releaseStages();
+			m_status = StatusReady;
+			reflect();
+			return *this;
+		}
+
+		for (auto&& [type, source] : m_sources) {
+			compile(source, type);
+		}
+		m_sources.clear();
+		m_cacheKey = key;
+		glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
 	glLinkProgram(m_id);
+	m_status = StatusPending;
 
+	return *this;
+}
+
+void Shader::resolve() {
+	GLint linked = GL_FALSE;
+	glGetProgramiv(m_id, GL_LINK_STATUS, &linked);
+
+	m_infoLog.clear();
+	if (linked == GL_FALSE) {
+		for (const ShaderMap* stages : { &m_subShaders, &m_sharedStages }) {
+			for (auto&& [type, shader] : *stages) {
+				GLint length = 0;
+				glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+				if (length > 1) {
+					std::vector<char> log(length);
+					glGetShaderInfoLog(shader, length, &length, log.data());
+					m_infoLog.append(log.data(), length);
+				}
+			}
+		}
+
+		GLint length = 0;
+		glGetProgramiv(m_id, GL_INFO_LOG_LENGTH, &length);
+		if (length > 1) {
+			std::vector<char> log(length);
+			glGetProgramInfoLog(m_id, length, &length, log.data());
+			m_infoLog.append(log.data(), length);
+		}
+	}
+
+	releaseStages();
+
+	m_status = linked ? StatusReady : StatusFailed;
+	if (m_status == StatusReady) {
+		reflect();
+		if (m_cacheKey != 0) {
+			m_cache->store(m_cacheKey, m_id);
+		}
+	}
+	m_cacheKey = 0;
+}
+
+void Shader::releaseStages() {
 	for (auto&& [type, shader] : m_subShaders) {
 		glDetachShader(m_id, shader);
 		glDeleteShader(shader);
 	}
+	m_subShaders.clear();
+	for (auto&& [type, shader] : m_sharedStages) {
+		glDetachShader(m_id, shader);
+	}
+	m_sharedStages.clear();
+}
+
+bool Shader::ready() {
+	if (m_status == StatusPending) {
+		if (GLAD_GL_KHR_parallel_shader_compile) {
+			GLint done = GL_FALSE;
+			glGetProgramiv(m_id, GL_COMPLETION_STATUS_KHR, &done);
+			if (done == GL_FALSE) {
+				return false;
+			}
+		}
+		resolve();
+	}
+	return m_status == StatusReady;
+}
+
+Shader& Shader::wait() {
+	if (m_status == StatusPending) {
+		resolve();
+	}
+	return *this;
+}
 
+Shader& Shader::fallback(const Shader& shader) {
+	m_fallback = &shader;
 	return *this;
 }
 
+Shader& Shader::replace(Shader& next) {
+	if (&next == this || !next.ready()) {
+		return *this;
+	}
+
+	for (u32 i = 0; i < m_uniformTable.size(); i++) {
+		const UniformInfo& info = m_uniformTable[i];
+		const bool known = i / 64 < m_shadowKnown.size() && (m_shadowKnown[i / 64] & (1ull << (i % 64)));
+		if (!known) continue;
+
+		const u32 j = next.findUniform(info.hash);
+		if (j == InvalidIndex || next.m_uniformTable[j].type != info.type) continue;
+		next.write(j, &m_shadowData[m_shadowSlots[i].offset], m_shadowSlots[i].size);
+	}
+
+	for (auto&& block : m_blockTable) {
+		const u32 j = next.findBlock(block.hash);
+		if (j == InvalidIndex) continue;
+
+		BlockInfo& target = next.m_blockTable[j];
+		if (target.interface != block.interface || target.binding == block.binding) continue;
+		if (block.interface == UniformBufferBlock) next.uniformBlockBinding(target.index, block.binding);
+		else next.storageBlockBinding(target.index, block.binding);
+		target.binding = block.binding;
+	}
+
+	const Shader* fallback = m_fallback;
+	ProgramCache* cache = m_cache;
+	DefineMap defines = std::move(m_defines);
+	const u32 generation = m_generation + 1;
+
+	destroy();
+	*this = std::move(next);
+	next = Shader{};
+
+	m_fallback = fallback;
+	m_cache = cache;
+	m_defines = std::move(defines);
+	m_generation = generation;
+	return *this;
+}
+
+GLuint Shader::activeId() const {
+	if (m_status != StatusReady && m_fallback) {
+		return m_fallback->activeId();
+	}
+	return m_id;
+}
+
+void Shader::maxCompilerThreads(u32 count) {
+	if (GLAD_GL_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(count);
+	}
+}
+
+static std::string resourceName(GLuint program, GLenum interface, u32 index, GLint length) {
+	std::string name(std::max(length, 1), '\0');
+	glGetProgramResourceName(program, interface, index, length, nullptr, &name[0]);
+	name.resize(std::max(length - 1, 0));
+
+	// Arrays are listed as "name[0]"; index them by the bare name.
+	const size_t len = name.size();
+	if (len > 3 && name.compare(len - 3, 3, "[0]") == 0) {
+		name.resize(len - 3);
+	}
+	return name;
+}
+
+template <typename Info>
+static u32 findHash(const std::vector<Info>& table, u64 hash) {
+	auto pos = std::lower_bound(table.begin(), table.end(), hash, [](const Info& info, u64 h) {
+		return info.hash < h;
+	});
+	if (pos == table.end() || pos->hash != hash) {
+		return Shader::InvalidIndex;
+	}
+	return u32(pos - table.begin());
+}
+
+template <typename Info>
+static void sortByHash(std::vector<Info>& table) {
+	std::sort(table.begin(), table.end(), [](const Info& a, const Info& b) {
+		return a.hash < b.hash;
+	});
+}
+
+void Shader::reflect() {
+	m_uniformTable.clear();
+	m_bufferVariableTable.clear();
+	m_blockTable.clear();
+	m_attributeTable.clear();
+
+	GLint count = 0;
+	glGetProgramInterfaceiv(m_id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+	for (i32 i = 0; i < count; i++) {
+		const GLenum props[] = {
+			GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX,
+			GL_OFFSET, GL_ARRAY_STRIDE, GL_MATRIX_STRIDE, GL_NAME_LENGTH
+		};
+		GLint v[8];
+		glGetProgramResourceiv(m_id, GL_UNIFORM, i, 8, props, 8, nullptr, v);
+
+		UniformInfo info;
+		info.name = resourceName(m_id, GL_UNIFORM, i, v[7]);
+		info.hash = hashString(info.name);
+		info.type = GLenum(v[0]);
+		info.location = v[1];
+		info.arraySize = v[2];
+		info.blockIndex = v[3];
+		info.offset = v[4];
+		info.arrayStride = v[5];
+		info.matrixStride = v[6];
+		m_uniformTable.push_back(info);
+	}
+
+	// Storage block members live in their own interface and have no location.
+	count = 0;
+	glGetProgramInterfaceiv(m_id, GL_BUFFER_VARIABLE, GL_ACTIVE_RESOURCES, &count);
+	for (i32 i = 0; i < count; i++) {
+		const GLenum props[] = {
+			GL_TYPE, GL_ARRAY_SIZE, GL_BLOCK_INDEX,
+			GL_OFFSET, GL_ARRAY_STRIDE, GL_MATRIX_STRIDE, GL_NAME_LENGTH
+		};
+		GLint v[7];
+		glGetProgramResourceiv(m_id, GL_BUFFER_VARIABLE, i, 7, props, 7, nullptr, v);
+
+		UniformInfo info;
+		info.name = resourceName(m_id, GL_BUFFER_VARIABLE, i, v[6]);
+		info.hash = hashString(info.name);
+		info.type = GLenum(v[0]);
+		info.location = -1;
+		info.arraySize = v[1];
+		info.blockIndex = v[2];
+		info.offset = v[3];
+		info.arrayStride = v[4];
+		info.matrixStride = v[5];
+		m_bufferVariableTable.push_back(info);
+	}
+
+	const std::pair<GLenum, ProgramInterface> blockInterfaces[] = {
+		{ GL_UNIFORM_BLOCK, UniformBufferBlock },
+		{ GL_SHADER_STORAGE_BLOCK, ShaderStorageBlock }
+	};
+	for (auto&& [glInterface, interface] : blockInterfaces) {
+		count = 0;
+		glGetProgramInterfaceiv(m_id, glInterface, GL_ACTIVE_RESOURCES, &count);
+		for (i32 i = 0; i < count; i++) {
+			const GLenum props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE, GL_NAME_LENGTH };
+			GLint v[3];
+			glGetProgramResourceiv(m_id, glInterface, i, 3, props, 3, nullptr, v);
+
+			BlockInfo info;
+			info.name = resourceName(m_id, glInterface, i, v[2]);
+			info.hash = hashString(info.name);
+			info.interface = interface;
+			info.index = u32(i);
+			info.binding = u32(v[0]);
+			info.size = u32(v[1]);
+			m_blockTable.push_back(info);
+		}
+	}
+
+	count = 0;
+	glGetProgramInterfaceiv(m_id, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &count);
+	for (i32 i = 0; i < count; i++) {
+		const GLenum props[] = { GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_NAME_LENGTH };
+		GLint v[4];
+		glGetProgramResourceiv(m_id, GL_PROGRAM_INPUT, i, 4, props, 4, nullptr, v);
+
+		// Built-ins such as gl_VertexID have no location.
+		if (v[1] < 0) continue;
+
+		AttributeInfo info;
+		info.name = resourceName(m_id, GL_PROGRAM_INPUT, i, v[3]);
+		info.hash = hashString(info.name);
+		info.type = GLenum(v[0]);
+		info.location = v[1];
+		info.arraySize = v[2];
+		m_attributeTable.push_back(info);
+	}
+
+	sortByHash(m_uniformTable);
+	sortByHash(m_bufferVariableTable);
+	sortByHash(m_blockTable);
+	sortByHash(m_attributeTable);
+
+	buildShadow();
+}
+
+enum UniformKind {
+	KindFloat,
+	KindInt,
+	KindUInt,
+	KindDouble,
+	KindMatrix
+};
+
+struct UniformLayout {
+	UniformKind kind;
+	u32 components;
+	u32 columns, rows;
+};
+
+static UniformLayout uniformLayout(GLenum type) {
+	switch (type) {
+		case GL_FLOAT: return { KindFloat, 1, 0, 0 };
+		case GL_FLOAT_VEC2: return { KindFloat, 2, 0, 0 };
+		case GL_FLOAT_VEC3: return { KindFloat, 3, 0, 0 };
+		case GL_FLOAT_VEC4: return { KindFloat, 4, 0, 0 };
+		case GL_DOUBLE: return { KindDouble, 1, 0, 0 };
+		case GL_DOUBLE_VEC2: return { KindDouble, 2, 0, 0 };
+		case GL_DOUBLE_VEC3: return { KindDouble, 3, 0, 0 };
+		case GL_DOUBLE_VEC4: return { KindDouble, 4, 0, 0 };
+		case GL_INT_VEC2: case GL_BOOL_VEC2: return { KindInt, 2, 0, 0 };
+		case GL_INT_VEC3: case GL_BOOL_VEC3: return { KindInt, 3, 0, 0 };
+		case GL_INT_VEC4: case GL_BOOL_VEC4: return { KindInt, 4, 0, 0 };
+		case GL_UNSIGNED_INT: return { KindUInt, 1, 0, 0 };
+		case GL_UNSIGNED_INT_VEC2: return { KindUInt, 2, 0, 0 };
+		case GL_UNSIGNED_INT_VEC3: return { KindUInt, 3, 0, 0 };
+		case GL_UNSIGNED_INT_VEC4: return { KindUInt, 4, 0, 0 };
+		case GL_FLOAT_MAT2: return { KindMatrix, 4, 2, 2 };
+		case GL_FLOAT_MAT3: return { KindMatrix, 9, 3, 3 };
+		case GL_FLOAT_MAT4: return { KindMatrix, 16, 4, 4 };
+		case GL_FLOAT_MAT2x3: return { KindMatrix, 6, 2, 3 };
+		case GL_FLOAT_MAT2x4: return { KindMatrix, 8, 2, 4 };
+		case GL_FLOAT_MAT3x2: return { KindMatrix, 6, 3, 2 };
+		case GL_FLOAT_MAT3x4: return { KindMatrix, 12, 3, 4 };
+		case GL_FLOAT_MAT4x2: return { KindMatrix, 8, 4, 2 };
+		case GL_FLOAT_MAT4x3: return { KindMatrix, 12, 4, 3 };
+		// int, bool and every sampler and image type.
+		default: return { KindInt, 1, 0, 0 };
+	}
+}
+
+void Shader::buildShadow() {
+	m_shadowSlots.assign(m_uniformTable.size(), ShadowSlot{ 0, 0 });
+
+	u32 size = 0;
+	for (u32 i = 0; i < m_uniformTable.size(); i++) {
+		const UniformInfo& info = m_uniformTable[i];
+		if (info.location < 0) continue;
+
+		const UniformLayout layout = uniformLayout(info.type);
+		const u32 scalar = layout.kind == KindDouble ? 8 : 4;
+		m_shadowSlots[i].offset = size;
+		m_shadowSlots[i].size = layout.components * scalar * u32(std::max(info.arraySize, 1));
+		size += m_shadowSlots[i].size;
+	}
+
+	const size_t words = (m_uniformTable.size() + 63) / 64;
+	m_shadowData.assign(size, 0);
+	m_shadowKnown.assign(words, 0);
+	m_shadowDirty.assign(words, 0);
+	m_dirtyCount = 0;
+}
+
+Shader& Shader::write(u32 index, const void* data, u32 size) {
+	if (index >= m_shadowSlots.size() || m_shadowSlots[index].size == 0) {
+		return *this;
+	}
+
+	const ShadowSlot& slot = m_shadowSlots[index];
+	size = std::min(size, slot.size);
+
+	u8* shadow = &m_shadowData[slot.offset];
+	const u64 bit = 1ull << (index % 64);
+	const u32 word = index / 64;
+
+	// The first write always goes through: GLSL initializers make the
+	// starting value unknown.
+	if ((m_shadowKnown[word] & bit) && std::memcmp(shadow, data, size) == 0) {
+		return *this;
+	}
+
+	std::memcpy(shadow, data, size);
+	m_shadowKnown[word] |= bit;
+	if (!(m_shadowDirty[word] & bit)) {
+		m_shadowDirty[word] |= bit;
+		m_dirtyCount++;
+	}
+	return *this;
+}
+
+void Shader::upload(u32 index) const {
+	const UniformInfo& info = m_uniformTable[index];
+	const UniformLayout layout = uniformLayout(info.type);
+	const u8* data = &m_shadowData[m_shadowSlots[index].offset];
+	const i32 count = std::max(info.arraySize, 1);
+	const i32 loc = info.location;
+
+	const f32* f = reinterpret_cast<const f32*>(data);
+	const i32* iv = reinterpret_cast<const i32*>(data);
+	const u32* uv = reinterpret_cast<const u32*>(data);
+	const f64* dv = reinterpret_cast<const f64*>(data);
+
+	switch (layout.kind) {
+		case KindFloat:
+			switch (layout.components) {
+				case 1: glProgramUniform1fv(m_id, loc, count, f); break;
+				case 2: glProgramUniform2fv(m_id, loc, count, f); break;
+				case 3: glProgramUniform3fv(m_id, loc, count, f); break;
+				case 4: glProgramUniform4fv(m_id, loc, count, f); break;
+			}
+			break;
+		case KindInt:
+			switch (layout.components) {
+				case 1: glProgramUniform1iv(m_id, loc, count, iv); break;
+				case 2: glProgramUniform2iv(m_id, loc, count, iv); break;
+				case 3: glProgramUniform3iv(m_id, loc, count, iv); break;
+				case 4: glProgramUniform4iv(m_id, loc, count, iv); break;
+			}
+			break;
+		case KindUInt:
+			switch (layout.components) {
+				case 1: glProgramUniform1uiv(m_id, loc, count, uv); break;
+				case 2: glProgramUniform2uiv(m_id, loc, count, uv); break;
+				case 3: glProgramUniform3uiv(m_id, loc, count, uv); break;
+				case 4: glProgramUniform4uiv(m_id, loc, count, uv); break;
+			}
+			break;
+		case KindDouble:
+			switch (layout.components) {
+				case 1: glProgramUniform1dv(m_id, loc, count, dv); break;
+				case 2: glProgramUniform2dv(m_id, loc, count, dv); break;
+				case 3: glProgramUniform3dv(m_id, loc, count, dv); break;
+				case 4: glProgramUniform4dv(m_id, loc, count, dv); break;
+			}
+			break;
+		case KindMatrix:
+			switch (info.type) {
+				case GL_FLOAT_MAT2: glProgramUniformMatrix2fv(m_id, loc, count, GL_FALSE, f); break;
+				case GL_FLOAT_MAT3: glProgramUniformMatrix3fv(m_id, loc, count, GL_FALSE, f); break;
+				case GL_FLOAT_MAT4: glProgramUniformMatrix4fv(m_id, loc, count, GL_FALSE, f); break;
+				case GL_FLOAT_MAT2x3: glProgramUniformMatrix2x3fv(m_id, loc, count, GL_FALSE, f); break;
+				case GL_FLOAT_MAT2x4: glProgramUniformMatrix2x4fv(m_id, loc, count, GL_FALSE, f); break;
+				case GL_FLOAT_MAT3x2: glProgramUniformMatrix3x2fv(m_id, loc, count, GL_FALSE, f); break;
+				case GL_FLOAT_MAT3x4: glProgramUniformMatrix3x4fv(m_id, loc, count, GL_FALSE, f); break;
+				case GL_FLOAT_MAT4x2: glProgramUniformMatrix4x2fv(m_id, loc, count, GL_FALSE, f); break;
+				case GL_FLOAT_MAT4x3: glProgramUniformMatrix4x3fv(m_id, loc, count, GL_FALSE, f); break;
+			}
+			break;
+	}
+}
+
+void Shader::flush() const {
+	if (m_dirtyCount == 0) {
+		return;
+	}
+
+	for (u32 w = 0; w < m_shadowDirty.size(); w++) {
+		u64 bits = m_shadowDirty[w];
+		while (bits) {
+			upload(w * 64 + bitScanForward64(bits));
+			bits &= bits - 1;
+		}
+		m_shadowDirty[w] = 0;
+	}
+	m_dirtyCount = 0;
+}
+
+// Whether `size` bytes of `scalar` (GL_FLOAT, GL_INT or GL_UNSIGNED_INT)
+// make up whole elements of the uniform, so upload() sends what was meant
+// and no stale bytes are left in the slot.
+bool Shader::accepts(u32 index, GLenum scalar, u32 size) const {
+	if (index >= m_shadowSlots.size() || m_shadowSlots[index].size == 0) {
+		return false;
+	}
+
+	const UniformLayout layout = uniformLayout(m_uniformTable[index].type);
+	bool kind = false;
+	switch (layout.kind) {
+		case KindFloat:
+		case KindMatrix: kind = scalar == GL_FLOAT; break;
+		case KindInt: kind = scalar == GL_INT; break;
+		case KindUInt: kind = scalar == GL_UNSIGNED_INT; break;
+		case KindDouble: kind = false; break;
+	}
+
+	const u32 element = layout.components * 4;
+	const bool fits = size > 0 && size % element == 0 && size <= m_shadowSlots[index].size;
+	assert((kind && fits) && "Shader::set: value does not match the uniform's type");
+	return kind && fits;
+}
+
+Shader& Shader::set(u32 index, i32 v) {
+	if (!accepts(index, GL_INT, sizeof(v))) return *this;
+	return write(index, &v, sizeof(v));
+}
+
+Shader& Shader::set(u32 index, u32 v) {
+	if (!accepts(index, GL_UNSIGNED_INT, sizeof(v))) return *this;
+	return write(index, &v, sizeof(v));
+}
+
+Shader& Shader::set(u32 index, f32 v) {
+	if (!accepts(index, GL_FLOAT, sizeof(v))) return *this;
+	return write(index, &v, sizeof(v));
+}
+
+Shader& Shader::set(u32 index, f32 x, f32 y) {
+	const f32 v[] = { x, y };
+	if (!accepts(index, GL_FLOAT, sizeof(v))) return *this;
+	return write(index, v, sizeof(v));
+}
+
+Shader& Shader::set(u32 index, f32 x, f32 y, f32 z) {
+	const f32 v[] = { x, y, z };
+	if (!accepts(index, GL_FLOAT, sizeof(v))) return *this;
+	return write(index, v, sizeof(v));
+}
+
+Shader& Shader::set(u32 index, f32 x, f32 y, f32 z, f32 w) {
+	const f32 v[] = { x, y, z, w };
+	if (!accepts(index, GL_FLOAT, sizeof(v))) return *this;
+	return write(index, v, sizeof(v));
+}
+
+Shader& Shader::set(u32 index, const f32* v, u32 count) {
+	if (!accepts(index, GL_FLOAT, u32(sizeof(f32) * count))) return *this;
+	return write(index, v, u32(sizeof(f32) * count));
+}
+
+Shader& Shader::set(u32 index, const i32* v, u32 count) {
+	if (!accepts(index, GL_INT, u32(sizeof(i32) * count))) return *this;
+	return write(index, v, u32(sizeof(i32) * count));
+}
+
+u32 Shader::findUniform(u64 hash) const {
+	return findHash(m_uniformTable, hash);
+}
+
+u32 Shader::findBlock(u64 hash) const {
+	return findHash(m_blockTable, hash);
+}
+
+u32 Shader::findAttribute(u64 hash) const {
+	return findHash(m_attributeTable, hash);
+}
+
+Shader::Uniform Shader::at(u32 index) const {
+	Uniform uni;
+	uni.loc = index < m_uniformTable.size() ? u32(m_uniformTable[index].location) : u32(-1);
+	return uni;
+}
+
 i32 Shader::getBlockIndex(Shader::ProgramInterface interface, const std::string& name) {
+	const u32 b = findBlock(hashString(name));
+	if (b != InvalidIndex && m_blockTable[b].interface == interface) {
+		return i32(m_blockTable[b].index);
+	}
+
 	auto pos = m_blockIndices.find(name);
 	if (pos == m_blockIndices.end()) {
 		i32 i = -2;
@@ -90,6 +736,11 @@ i32 Shader::getBlockIndex(Shader::ProgramInterface interface, const std::string&
 }
 
 i32 Shader::getUniformIndex(const std::string& name) {
+	const u32 u = findUniform(hashString(name));
+	if (u != InvalidIndex) {
+		return m_uniformTable[u].location;
+	}
+
 	auto pos = m_uniforms.find(name);
 	if (pos == m_uniforms.end()) {
 		i32 i = glGetProgramResourceLocation(m_id, GL_UNIFORM, name.c_str());
@@ -103,6 +754,11 @@ i32 Shader::getUniformIndex(const std::string& name) {
 }
 
 i32 Shader::getAttributeIndex(const std::string& name) {
+	const u32 a = findAttribute(hashString(name));
+	if (a != InvalidIndex) {
+		return m_attributeTable[a].location;
+	}
+
 	auto pos = m_attributes.find(name);
 	if (pos == m_attributes.end()) {
 		i32 i = glGetAttribLocation(m_id, name.c_str());
@@ -143,6 +799,10 @@ void Shader::Uniform::set(f32 x, f32 y, f32 z, f32 w) {
 	glUniform4f(loc, x, y, z, w);
 }
 
+void Shader::Uniform::vec4(const f32* v, u32 count) {
+	glUniform4fv(loc, count, v);
+}
+
 void Shader::Uniform::mat3(const f32* v, u32 count, bool transpose) {
 	glUniformMatrix3fv(loc, count, transpose, v);
 }
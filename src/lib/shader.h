@@ -4,9 +4,14 @@
 #include <string>
 #include <unordered_map>
 #include <optional>
+#include <vector>
+#include <map>
 
 #include "glad/glad.h"
 #include "integer.h"
+#include "hash.h"
+
+class ProgramCache;
 
 class Shader {
 public:
@@ -17,6 +22,13 @@ public:
 		ComputeShader = GL_COMPUTE_SHADER
 	};
 
+	enum Status {
+		StatusUnlinked = 0,
+		StatusPending,
+		StatusReady,
+		StatusFailed
+	};
+
 	enum ProgramInterface {
 		ShaderStorageBlock,
 		UniformBufferBlock
@@ -29,12 +41,47 @@ public:
 		void set(f32 x, f32 y);
 		void set(f32 x, f32 y, f32 z);
 		void set(f32 x, f32 y, f32 z, f32 w);
+		void vec4(const f32* v, u32 count);
 		void mat3(const f32* v, u32 count, bool transpose = false);
 		void mat4(const f32* v, u32 count, bool transpose = false);
 	};
 
+	// Reflected program resources, each table sorted by name hash so the
+	// position of an entry is a stable index for the program's lifetime.
+	struct UniformInfo {
+		u64 hash;
+		std::string name;
+		GLenum type;
+		i32 location;
+		i32 arraySize;
+		i32 blockIndex; // -1 unless a block member
+		i32 offset;     // byte offset inside the block
+		i32 arrayStride;
+		i32 matrixStride;
+	};
+
+	struct BlockInfo {
+		u64 hash;
+		std::string name;
+		ProgramInterface interface;
+		u32 index;
+		u32 binding;
+		u32 size;
+	};
+
+	struct AttributeInfo {
+		u64 hash;
+		std::string name;
+		GLenum type;
+		i32 location;
+		i32 arraySize;
+	};
+
+	static constexpr u32 InvalidIndex = ~0u;
+
 	using ShaderMap = std::unordered_map<ShaderType, GLuint>;
 	using ValueMap = std::unordered_map<std::string, GLuint>;
+	using DefineMap = std::map<std::string, std::string>;
 
 	Shader() = default;
 	~Shader() = default;
@@ -42,12 +89,59 @@ public:
 	Shader& create();
 	void destroy();
 
+	// Resolves a pending link first, blocking unless a fallback is set.
 	Shader& bind();
 	Shader& unbind();
 
+	// With a cache attached, add() only records sources and link() tries
+	// the cached binary before compiling anything. Programs with attach()ed
+	// stages always link from source, as the key can't describe those.
+	Shader& cache(ProgramCache& cache);
+
+	// Injected after the #version line of every stage added afterwards.
+	Shader& define(const std::string& name, const std::string& value = "");
+
+	// Neither add() nor link() waits for the driver: status is only queried
+	// by ready() or wait(), so many programs can compile in parallel.
 	Shader& add(const std::string& source, ShaderType type);
 	Shader& link();
 
+	// Marks the program for use in a ProgramPipeline; call before link().
+	Shader& separable(bool enabled = true);
+
+	// Attaches a compiled stage owned elsewhere, e.g. shared between
+	// variants. It is detached once linked but never deleted here.
+	Shader& attach(GLuint stage, ShaderType type);
+
+	// Non-blocking with GL_KHR_parallel_shader_compile, otherwise resolves
+	// the link status right away.
+	bool ready();
+	Shader& wait();
+
+	// Program bound in place of this one until it is ready (or if it fails).
+	Shader& fallback(const Shader& shader);
+
+	// Takes over a successfully linked program, e.g. a rebuilt version of
+	// this one, and deletes the current one; does nothing unless `next` is
+	// ready. Shadowed uniform values and block bindings carry over by name.
+	// The reflection tables are replaced as a whole, so indices from
+	// findUniform() and friends belong to a generation(): re-resolve them
+	// when it changes. `next` is left empty.
+	Shader& replace(Shader& next);
+
+	// Bumped by every replace().
+	u32 generation() const { return m_generation; }
+
+	Status status() const { return m_status; }
+	const DefineMap& defines() const { return m_defines; }
+	const std::string& infoLog() const { return m_infoLog; }
+
+	// Hint for how many driver threads may compile shaders in the background.
+	static void maxCompilerThreads(u32 count);
+
+	// Inserts one #define line per entry after the #version line.
+	static std::string injectDefines(const std::string& source, const DefineMap& defines);
+
 	i32 getBlockIndex(ProgramInterface interface, const std::string& name);
 	i32 getUniformIndex(const std::string& name);
 	i32 getAttributeIndex(const std::string& name);
@@ -57,13 +151,92 @@ public:
 
 	Uniform get(const std::string& name);
 
+	// Table lookups by name hash, e.g. findUniform("tex"_h). Valid once
+	// the program is ready; return InvalidIndex for unknown names.
+	u32 findUniform(u64 hash) const;
+	u32 findBlock(u64 hash) const;
+	u32 findAttribute(u64 hash) const;
+
+	// Uniform at a reflected index; an invalid index gives location -1,
+	// which GL ignores.
+	Uniform at(u32 index) const;
+
+	// Shadowed writes to default-block uniforms by reflected index. A value
+	// equal to the last one written is dropped; changed ones are marked
+	// dirty and uploaded by flush() with glProgramUniform*, so the program
+	// need not be bound. bind() flushes too. Writes through Uniform::set
+	// bypass the shadow. A write must be whole elements of the uniform's
+	// scalar type (i32 for samplers and bools); others are rejected, and
+	// assert in debug builds.
+	Shader& set(u32 index, i32 v);
+	Shader& set(u32 index, u32 v);
+	Shader& set(u32 index, f32 v);
+	Shader& set(u32 index, f32 x, f32 y);
+	Shader& set(u32 index, f32 x, f32 y, f32 z);
+	Shader& set(u32 index, f32 x, f32 y, f32 z, f32 w);
+	Shader& set(u32 index, const f32* v, u32 count);
+	Shader& set(u32 index, const i32* v, u32 count);
+
+	void flush() const;
+	bool dirty() const { return m_dirtyCount > 0; }
+
+	const std::vector<UniformInfo>& uniforms() const { return m_uniformTable; }
+	const std::vector<BlockInfo>& blocks() const { return m_blockTable; }
+	const std::vector<UniformInfo>& bufferVariables() const { return m_bufferVariableTable; }
+	const std::vector<AttributeInfo>& attributes() const { return m_attributeTable; }
+
 	GLuint id() const { return m_id; }
 
+	// GL_*_SHADER_BIT mask of the stages added or attached.
+	u32 stages() const { return m_stages; }
+	bool isSeparable() const { return m_separable; }
+
+	// The program to actually bind: this one, or the fallback while pending.
+	GLuint activeId() const;
+
 private:
 	GLuint m_id{ 0 };
-	ShaderMap m_subShaders;
+	ShaderMap m_subShaders, m_sharedStages;
+	u32 m_stages{ 0 };
+	bool m_separable{ false };
+	u32 m_generation{ 0 };
+
+	Status m_status{ StatusUnlinked };
+	std::string m_infoLog;
+	const Shader* m_fallback{ nullptr };
+
+	ProgramCache* m_cache{ nullptr };
+	u64 m_cacheKey{ 0 };
+	std::vector<std::pair<ShaderType, std::string>> m_sources;
+	DefineMap m_defines;
 
 	ValueMap m_attributes, m_uniforms, m_blockIndices;
+
+	std::vector<UniformInfo> m_uniformTable, m_bufferVariableTable;
+	std::vector<BlockInfo> m_blockTable;
+	std::vector<AttributeInfo> m_attributeTable;
+
+	struct ShadowSlot {
+		u32 offset, size;
+	};
+
+	// Shadow copies of the default-block uniforms, parallel to m_uniformTable.
+	std::vector<u8> m_shadowData;
+	std::vector<ShadowSlot> m_shadowSlots;
+	std::vector<u64> m_shadowKnown;
+	mutable std::vector<u64> m_shadowDirty;
+	mutable u32 m_dirtyCount{ 0 };
+
+	void reflect();
+	void buildShadow();
+	bool accepts(u32 index, GLenum scalar, u32 size) const;
+	Shader& write(u32 index, const void* data, u32 size);
+	void upload(u32 index) const;
+
+	void compile(const std::string& source, ShaderType type);
+	void resolve();
+	void releaseStages();
+	std::string applyDefines(const std::string& source) const;
 };
 
 #endif // GFXE_SHADER_H
\ No newline at end of file
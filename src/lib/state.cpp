@@ -0,0 +1,219 @@
+#include "state.h"
+
+#include "caps.h"
+
+#include <algorithm>
+
+u64 StateCache::Counters::totalIssued() const {
+	u64 total = 0;
+	for (u32 i = 0; i < CategoryCount; i++) total += issued[i];
+	return total;
+}
+
+u64 StateCache::Counters::totalElided() const {
+	u64 total = 0;
+	for (u32 i = 0; i < CategoryCount; i++) total += elided[i];
+	return total;
+}
+
+StateCache& StateCache::get() {
+	static StateCache cache;
+	return cache;
+}
+
+bool StateCache::elide(Category category, bool unchanged) {
+	if (unchanged) {
+		m_counters.elided[category]++;
+	} else {
+		m_counters.issued[category]++;
+	}
+	return unchanged;
+}
+
+void StateCache::invalidate() {
+	m_program = Unknown;
+	m_pipeline = Unknown;
+	m_vertexArray = Unknown;
+	m_drawFramebuffer = Unknown;
+	m_readFramebuffer = Unknown;
+	m_activeUnit = Unknown;
+	m_textures.clear();
+	m_buffers.clear();
+	m_indexedBuffers.clear();
+	m_drawBuffers.clear();
+	m_viewportKnown = false;
+}
+
+void StateCache::useProgram(GLuint id) {
+	if (elide(CategoryProgram, m_program == id)) return;
+	glUseProgram(id);
+	m_program = id;
+}
+
+// Only takes effect while no program is in use.
+void StateCache::bindProgramPipeline(GLuint id) {
+	if (elide(CategoryProgram, m_pipeline == id)) return;
+	glBindProgramPipeline(id);
+	m_pipeline = id;
+}
+
+void StateCache::bindVertexArray(GLuint id) {
+	if (elide(CategoryVertexArray, m_vertexArray == id)) return;
+	glBindVertexArray(id);
+	m_vertexArray = id;
+
+	// The element buffer binding belongs to the vertex array.
+	m_buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+}
+
+void StateCache::activeTexture(u32 unit) {
+	if (m_activeUnit == unit) return;
+	glActiveTexture(GL_TEXTURE0 + unit);
+	m_activeUnit = unit;
+}
+
+void StateCache::bindTexture(u32 unit, GLenum target, GLuint id) {
+	if (unit >= m_textures.size()) {
+		m_textures.resize(unit + 1);
+	}
+
+	TextureUnit& tu = m_textures[unit];
+	if (elide(CategoryTexture, tu.id == id && tu.target == target)) return;
+
+	// glBindTextureUnit leaves the active unit alone, and with id 0 clears the unit.
+	if (Caps::directStateAccess()) {
+		glBindTextureUnit(unit, id);
+	} else {
+		activeTexture(unit);
+		glBindTexture(target, id);
+	}
+	tu.target = target;
+	tu.id = id;
+}
+
+void StateCache::unbindTexture(GLenum target) {
+	if (m_activeUnit == Unknown) {
+		// No idea which unit this lands on, so no cached unit can be trusted.
+		glBindTexture(target, 0);
+		m_textures.clear();
+		m_counters.issued[CategoryTexture]++;
+		return;
+	}
+	bindTexture(m_activeUnit, target, 0);
+}
+
+void StateCache::bindBuffer(GLenum target, GLuint id) {
+	auto pos = m_buffers.find(target);
+	if (elide(CategoryBuffer, pos != m_buffers.end() && pos->second == id)) return;
+	glBindBuffer(target, id);
+	m_buffers[target] = id;
+}
+
+static u64 indexedKey(GLenum target, u32 index) {
+	return (u64(target) << 32) | u64(index);
+}
+
+void StateCache::bindBufferBase(GLenum target, u32 index, GLuint id) {
+	IndexedBinding& b = m_indexedBuffers[indexedKey(target, index)];
+	if (elide(CategoryBuffer, b.id == id && b.size == 0)) return;
+	glBindBufferBase(target, index, id);
+	b.id = id;
+	b.offset = 0;
+	b.size = 0;
+
+	// Indexed binds also replace the generic binding point.
+	m_buffers[target] = id;
+}
+
+void StateCache::bindBufferRange(GLenum target, u32 index, GLuint id, u32 offset, u32 size) {
+	IndexedBinding& b = m_indexedBuffers[indexedKey(target, index)];
+	if (elide(CategoryBuffer, b.id == id && b.offset == offset && b.size == size)) return;
+	glBindBufferRange(target, index, id, offset, size);
+	b.id = id;
+	b.offset = offset;
+	b.size = size;
+	m_buffers[target] = id;
+}
+
+void StateCache::bindFramebuffer(GLenum target, GLuint id) {
+	bool unchanged = false;
+	switch (target) {
+		case GL_DRAW_FRAMEBUFFER: unchanged = m_drawFramebuffer == id; break;
+		case GL_READ_FRAMEBUFFER: unchanged = m_readFramebuffer == id; break;
+		default: unchanged = m_drawFramebuffer == id && m_readFramebuffer == id; break;
+	}
+	if (elide(CategoryFramebuffer, unchanged)) return;
+
+	glBindFramebuffer(target, id);
+	if (target != GL_READ_FRAMEBUFFER) m_drawFramebuffer = id;
+	if (target != GL_DRAW_FRAMEBUFFER) m_readFramebuffer = id;
+}
+
+void StateCache::viewport(i32 x, i32 y, i32 w, i32 h) {
+	const bool unchanged = m_viewportKnown &&
+		m_viewport[0] == x && m_viewport[1] == y &&
+		m_viewport[2] == w && m_viewport[3] == h;
+	if (elide(CategoryViewport, unchanged)) return;
+
+	glViewport(x, y, w, h);
+	m_viewport[0] = x;
+	m_viewport[1] = y;
+	m_viewport[2] = w;
+	m_viewport[3] = h;
+	m_viewportKnown = true;
+}
+
+bool StateCache::getViewport(i32* out) const {
+	if (!m_viewportKnown) return false;
+	std::copy(m_viewport, m_viewport + 4, out);
+	return true;
+}
+
+void StateCache::drawBuffers(GLuint fbo, u32 count, const GLenum* buffers) {
+	auto pos = m_drawBuffers.find(fbo);
+	const bool unchanged = pos != m_drawBuffers.end() &&
+		pos->second.size() == count &&
+		std::equal(buffers, buffers + count, pos->second.begin());
+	if (elide(CategoryDrawBuffers, unchanged)) return;
+
+	if (Caps::directStateAccess()) {
+		glNamedFramebufferDrawBuffers(fbo, count, buffers);
+	} else {
+		bindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+		glDrawBuffers(count, buffers);
+	}
+	m_drawBuffers[fbo] = std::vector<GLenum>(buffers, buffers + count);
+}
+
+void StateCache::forgetProgram(GLuint id) {
+	if (m_program == id) m_program = Unknown;
+}
+
+void StateCache::forgetProgramPipeline(GLuint id) {
+	if (m_pipeline == id) m_pipeline = Unknown;
+}
+
+void StateCache::forgetVertexArray(GLuint id) {
+	if (m_vertexArray == id) m_vertexArray = Unknown;
+}
+
+void StateCache::forgetTexture(GLuint id) {
+	for (auto&& tu : m_textures) {
+		if (tu.id == id) tu.id = Unknown;
+	}
+}
+
+void StateCache::forgetBuffer(GLuint id) {
+	for (auto&& [target, buf] : m_buffers) {
+		if (buf == id) buf = Unknown;
+	}
+	for (auto&& [key, b] : m_indexedBuffers) {
+		if (b.id == id) b.id = Unknown;
+	}
+}
+
+void StateCache::forgetFramebuffer(GLuint id) {
+	if (m_drawFramebuffer == id) m_drawFramebuffer = Unknown;
+	if (m_readFramebuffer == id) m_readFramebuffer = Unknown;
+	m_drawBuffers.erase(id);
+}
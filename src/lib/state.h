@@ -0,0 +1,104 @@
+#ifndef GFXE_STATE_H
+#define GFXE_STATE_H
+
+#include <vector>
+#include <unordered_map>
+
+#include "integer.h"
+#include "glad/glad.h"
+
+// Shadow of the context's binding state. Binds that would not change anything
+// are skipped. Code issuing raw GL binds behind its back must call invalidate().
+class StateCache {
+public:
+	enum Category {
+		CategoryProgram = 0,
+		CategoryVertexArray,
+		CategoryTexture,
+		CategoryBuffer,
+		CategoryFramebuffer,
+		CategoryViewport,
+		CategoryDrawBuffers,
+		CategoryCount
+	};
+
+	struct Counters {
+		u64 issued[CategoryCount]{};
+		u64 elided[CategoryCount]{};
+
+		u64 totalIssued() const;
+		u64 totalElided() const;
+	};
+
+	static StateCache& get();
+
+	void invalidate();
+
+	void useProgram(GLuint id);
+	void bindProgramPipeline(GLuint id);
+	void bindVertexArray(GLuint id);
+
+	void activeTexture(u32 unit);
+	void bindTexture(u32 unit, GLenum target, GLuint id);
+	// Unbinds from the active unit. Prefer bindTexture(unit, target, 0).
+	void unbindTexture(GLenum target);
+
+	void bindBuffer(GLenum target, GLuint id);
+	void bindBufferBase(GLenum target, u32 index, GLuint id);
+	void bindBufferRange(GLenum target, u32 index, GLuint id, u32 offset, u32 size);
+
+	void bindFramebuffer(GLenum target, GLuint id);
+	void viewport(i32 x, i32 y, i32 w, i32 h);
+	void drawBuffers(GLuint fbo, u32 count, const GLenum* buffers);
+
+	// The last viewport set through the cache. Returns false if unknown.
+	bool getViewport(i32* out) const;
+
+	GLuint program() const { return m_program; }
+	GLuint programPipeline() const { return m_pipeline; }
+	GLuint vertexArray() const { return m_vertexArray; }
+	GLuint drawFramebuffer() const { return m_drawFramebuffer; }
+	GLuint readFramebuffer() const { return m_readFramebuffer; }
+
+	// Must be called when an object is deleted, as GL may hand its name out again.
+	void forgetProgram(GLuint id);
+	void forgetProgramPipeline(GLuint id);
+	void forgetVertexArray(GLuint id);
+	void forgetTexture(GLuint id);
+	void forgetBuffer(GLuint id);
+	void forgetFramebuffer(GLuint id);
+
+	const Counters& counters() const { return m_counters; }
+	void resetCounters() { m_counters = Counters{}; }
+
+private:
+	static constexpr GLuint Unknown = ~0u;
+
+	struct TextureUnit {
+		GLenum target{ 0 };
+		GLuint id{ Unknown };
+	};
+
+	struct IndexedBinding {
+		GLuint id{ Unknown };
+		u32 offset{ 0 }, size{ 0 };
+	};
+
+	GLuint m_program{ Unknown }, m_pipeline{ Unknown }, m_vertexArray{ Unknown };
+	GLuint m_drawFramebuffer{ Unknown }, m_readFramebuffer{ Unknown };
+	u32 m_activeUnit{ Unknown };
+
+	std::vector<TextureUnit> m_textures;
+	std::unordered_map<GLenum, GLuint> m_buffers;
+	std::unordered_map<u64, IndexedBinding> m_indexedBuffers;
+	std::unordered_map<GLuint, std::vector<GLenum>> m_drawBuffers;
+
+	i32 m_viewport[4]{ 0, 0, 0, 0 };
+	bool m_viewportKnown{ false };
+
+	Counters m_counters;
+
+	bool elide(Category category, bool unchanged);
+};
+
+#endif // GFXE_STATE_H
@@ -0,0 +1,152 @@
+#include "sync.h"
+
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+GpuFence::GpuFence(GpuFence&& other) noexcept
+	: m_sync(other.m_sync), m_lastWaitNs(other.m_lastWaitNs) {
+	other.m_sync = nullptr;
+}
+
+GpuFence& GpuFence::operator=(GpuFence&& other) noexcept {
+	if (this != &other) {
+		destroy();
+		m_sync = other.m_sync;
+		m_lastWaitNs = other.m_lastWaitNs;
+		other.m_sync = nullptr;
+	}
+	return *this;
+}
+
+GpuFence& GpuFence::signal() {
+	destroy();
+	m_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	return *this;
+}
+
+void GpuFence::destroy() {
+	if (m_sync) {
+		glDeleteSync(m_sync);
+		m_sync = nullptr;
+	}
+}
+
+bool GpuFence::signaled() {
+	if (!m_sync) {
+		return true;
+	}
+
+	GLint status = GL_UNSIGNALED;
+	glGetSynciv(m_sync, GL_SYNC_STATUS, 1, nullptr, &status);
+	if (status == GL_SIGNALED) {
+		destroy();
+		return true;
+	}
+	return false;
+}
+
+GpuFence::WaitResult GpuFence::wait(u64 timeoutNs) {
+	m_lastWaitNs = 0;
+	if (!m_sync) {
+		return WaitSignaled;
+	}
+
+	auto start = Clock::now();
+	GLenum res = glClientWaitSync(m_sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNs);
+	m_lastWaitNs = u64(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+	switch (res) {
+		case GL_ALREADY_SIGNALED:
+		case GL_CONDITION_SATISFIED:
+			destroy();
+			return WaitSignaled;
+		case GL_TIMEOUT_EXPIRED:
+			return WaitTimedOut;
+		default:
+			return WaitFailed;
+	}
+}
+
+GpuFence& GpuFence::gpuWait() {
+	if (m_sync) {
+		glWaitSync(m_sync, 0, GL_TIMEOUT_IGNORED);
+	}
+	return *this;
+}
+
+void GpuTimeline::destroy() {
+	for (auto&& point : m_points) {
+		point.fence.destroy();
+	}
+	m_points.clear();
+}
+
+u64 GpuTimeline::signal() {
+	Point point;
+	point.value = m_next++;
+	point.fence.signal();
+	m_points.push_back(std::move(point));
+	return m_next - 1;
+}
+
+void GpuTimeline::retire() {
+	while (!m_points.empty() && m_points.front().fence.signaled()) {
+		m_completed = m_points.front().value;
+		m_points.pop_front();
+	}
+}
+
+bool GpuTimeline::reached(u64 point) {
+	if (point <= m_completed) {
+		return true;
+	}
+	retire();
+	return point <= m_completed;
+}
+
+GpuFence::WaitResult GpuTimeline::wait(u64 point, u64 timeoutNs) {
+	if (reached(point)) {
+		return GpuFence::WaitSignaled;
+	}
+
+	// Only points handed out by pending() or signal() can ever complete.
+	if (point > m_next) {
+		return GpuFence::WaitFailed;
+	}
+
+	// The pending point was never fenced; fence now so there is something to wait on.
+	if (point == m_next) {
+		signal();
+	}
+
+	u64 waited = 0;
+	GpuFence::WaitResult res = GpuFence::WaitSignaled;
+	while (!m_points.empty() && m_points.front().value <= point) {
+		Point& front = m_points.front();
+
+		u64 budget = timeoutNs;
+		if (timeoutNs != GL_TIMEOUT_IGNORED) {
+			if (waited >= timeoutNs) {
+				res = GpuFence::WaitTimedOut;
+				break;
+			}
+			budget = timeoutNs - waited;
+		}
+
+		res = front.fence.wait(budget);
+		waited += front.fence.lastWaitNs();
+		if (res != GpuFence::WaitSignaled) {
+			break;
+		}
+
+		m_completed = front.value;
+		m_points.pop_front();
+	}
+
+	m_stats.waits++;
+	m_stats.lastNs = waited;
+	m_stats.totalNs += waited;
+
+	return res;
+}
@@ -0,0 +1,92 @@
+#ifndef GFXE_SYNC_H
+#define GFXE_SYNC_H
+
+#include <deque>
+
+#include "integer.h"
+#include "glad/glad.h"
+
+class GpuFence {
+public:
+	enum WaitResult {
+		WaitSignaled,
+		WaitTimedOut,
+		WaitFailed
+	};
+
+	GpuFence() = default;
+	~GpuFence() = default;
+
+	// Owns its sync object, so it can be moved but not copied.
+	GpuFence(const GpuFence&) = delete;
+	GpuFence& operator=(const GpuFence&) = delete;
+	GpuFence(GpuFence&& other) noexcept;
+	GpuFence& operator=(GpuFence&& other) noexcept;
+
+	// Fences all commands submitted so far, replacing any previous fence.
+	GpuFence& signal();
+	void destroy();
+
+	// Non-blocking check. Returns true if there is nothing to wait for.
+	bool signaled();
+
+	// Blocks the calling thread until the fence is signaled or timeoutNs expires.
+	WaitResult wait(u64 timeoutNs = GL_TIMEOUT_IGNORED);
+
+	// Makes the GPU wait on the fence without blocking the CPU.
+	GpuFence& gpuWait();
+
+	bool pending() const { return m_sync != nullptr; }
+	u64 lastWaitNs() const { return m_lastWaitNs; }
+
+private:
+	GLsync m_sync{ nullptr };
+	u64 m_lastWaitNs{ 0 };
+};
+
+// Monotonic sequence of fenced points. Resources record the point of their
+// last use, and callers wait only for that point instead of the whole pipeline.
+class GpuTimeline {
+public:
+	struct WaitStats {
+		u32 waits{ 0 };
+		u64 totalNs{ 0 };
+		u64 lastNs{ 0 };
+	};
+
+	GpuTimeline() = default;
+	~GpuTimeline() = default;
+
+	void destroy();
+
+	// Fences the commands submitted so far and returns the point they complete.
+	u64 signal();
+
+	// The point that the next signal() will fence. Used to tag resources.
+	u64 pending() const { return m_next; }
+	u64 completed() const { return m_completed; }
+
+	bool reached(u64 point);
+
+	// timeoutNs bounds the whole wait, across every fence up to point.
+	// Points past pending() were never handed out and fail right away.
+	GpuFence::WaitResult wait(u64 point, u64 timeoutNs = GL_TIMEOUT_IGNORED);
+
+	const WaitStats& stats() const { return m_stats; }
+	void resetStats() { m_stats = WaitStats{}; }
+
+private:
+	struct Point {
+		u64 value;
+		GpuFence fence;
+	};
+
+	std::deque<Point> m_points;
+	u64 m_next{ 1 }, m_completed{ 0 };
+
+	WaitStats m_stats;
+
+	void retire();
+};
+
+#endif // GFXE_SYNC_H
@@ -1,9 +1,14 @@
 #include "texture.h"
+#include "state.h"
+
+#include <algorithm>
 
 void Texture::destroy() {
 	if (m_id) {
+		StateCache::get().forgetTexture(m_id);
 		glDeleteTextures(1, &m_id);
 		m_id = 0;
+		m_immutable = false;
 	}
 }
 
@@ -13,7 +18,11 @@ Texture& Texture::create(
 	u32 width, u32 height, u32 depth,
 	bool floatingPoint, u32 depthSize
 ) {
-	glGenTextures(1, &m_id);
+	if (Caps::directStateAccess()) {
+		glCreateTextures(type, 1, &m_id);
+	} else {
+		glGenTextures(1, &m_id);
+	}
 	m_type = type;
 	m_format = format;
 	m_floatingPoint = floatingPoint;
@@ -25,13 +34,24 @@ Texture& Texture::create(
 }
 
 Texture& Texture::wrapMode(TextureWrap s, TextureWrap t, TextureWrap r) {
+	if (Caps::directStateAccess()) {
+		if (s != TextureWrap::WrapNone) glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, s);
+		if (t != TextureWrap::WrapNone) glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, t);
+		if (r != TextureWrap::WrapNone) glTextureParameteri(m_id, GL_TEXTURE_WRAP_R, r);
+		return *this;
+	}
 	if (s != TextureWrap::WrapNone) glTexParameteri(m_type, GL_TEXTURE_WRAP_S, s);
 	if (t != TextureWrap::WrapNone) glTexParameteri(m_type, GL_TEXTURE_WRAP_T, t);
-	if (r != TextureWrap::WrapNone) glTexParameteri(m_type, GL_TEXTURE_WRAP_R, t);
+	if (r != TextureWrap::WrapNone) glTexParameteri(m_type, GL_TEXTURE_WRAP_R, r);
 	return *this;
 }
 
 Texture& Texture::filter(TextureFilter min, TextureFilter mag) {
+	if (Caps::directStateAccess()) {
+		glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, min);
+		glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, mag);
+		return *this;
+	}
 	glTexParameteri(m_type, GL_TEXTURE_MIN_FILTER, min);
 	glTexParameteri(m_type, GL_TEXTURE_MAG_FILTER, mag);
 	return *this;
@@ -39,27 +59,88 @@ Texture& Texture::filter(TextureFilter min, TextureFilter mag) {
 
 Texture& Texture::array(u32 layerCount) {
 	if (layerCount > 0 && m_type == TextureType::Texture2DArray) {
-		glTexStorage3D(
-			m_type, 0,
-			getInternalFormat(m_format, m_floatingPoint, m_depthSize),
-			m_width, m_height,
-			layerCount
-		);
 		m_layerCount = layerCount;
+		storage(1);
+	}
+	return *this;
+}
+
+Texture& Texture::storage(u32 levels) {
+	if (m_immutable) {
+		return *this;
+	}
+
+	if (levels == 0) {
+		// Only a 3D texture's depth is mipmapped; array layers are not.
+		u32 size = std::max(m_width, m_height);
+		if (m_type == TextureType::Texture3D) size = std::max(size, m_depth);
+		while (size > 0) {
+			levels++;
+			size >>= 1;
+		}
+	}
+
+	const GLenum ifmt = getInternalFormat(m_format, m_floatingPoint, m_depthSize);
+	const bool dsa = Caps::directStateAccess();
+	switch (m_type) {
+		case TextureType::Texture1D:
+			if (dsa) glTextureStorage1D(m_id, levels, ifmt, m_width);
+			else glTexStorage1D(m_type, levels, ifmt, m_width);
+			break;
+		case TextureType::Texture2D:
+		case TextureType::CubeMap:
+			if (dsa) glTextureStorage2D(m_id, levels, ifmt, m_width, m_height);
+			else glTexStorage2D(m_type, levels, ifmt, m_width, m_height);
+			break;
+		case TextureType::Texture2DArray:
+			if (dsa) glTextureStorage3D(m_id, levels, ifmt, m_width, m_height, m_layerCount);
+			else glTexStorage3D(m_type, levels, ifmt, m_width, m_height, m_layerCount);
+			break;
+		case TextureType::Texture3D:
+			if (dsa) glTextureStorage3D(m_id, levels, ifmt, m_width, m_height, m_depth);
+			else glTexStorage3D(m_type, levels, ifmt, m_width, m_height, m_depth);
+			break;
+		default: return *this;
 	}
+	m_immutable = true;
 	return *this;
 }
 
 Texture& Texture::updateCube(const u8* data, CubeMapSide side, DataType dataType) {
-	GLenum ifmt = getInternalFormat(m_format, m_floatingPoint, m_depthSize);
-	if (m_type == TextureType::CubeMap) {
-		glTexImage2D(side, 0, ifmt, m_width, m_height, 0, m_format, dataType, data);
+	if (m_type != TextureType::CubeMap) {
+		return *this;
 	}
+
+	if (Caps::directStateAccess()) {
+		storage();
+		if (data) {
+			const u32 face = u32(side) - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+			glTextureSubImage3D(m_id, 0, 0, 0, face, m_width, m_height, 1, m_format, dataType, data);
+		}
+		return *this;
+	}
+
+	GLenum ifmt = getInternalFormat(m_format, m_floatingPoint, m_depthSize);
+	glTexImage2D(side, 0, ifmt, m_width, m_height, 0, m_format, dataType, data);
 	return *this;
 }
 
 Texture& Texture::updateArray(const u8* data, DataType dataType) {
 	if (m_layerCount > 0 && m_type == TextureType::Texture2DArray) {
+		if (!data) {
+			return *this;
+		}
+		if (Caps::directStateAccess()) {
+			glTextureSubImage3D(
+				m_id,
+				0, 0, 0, 0,
+				m_width, m_height, m_layerCount,
+				m_format,
+				dataType,
+				data
+			);
+			return *this;
+		}
 		glTexSubImage3D(
 			m_type,
 			0, 0, 0, 0,
@@ -75,6 +156,28 @@ Texture& Texture::updateArray(const u8* data, DataType dataType) {
 }
 
 Texture& Texture::update(const u8* data, DataType dataType) {
+	if (Caps::directStateAccess()) {
+		// Named textures have no mutable image specification, so allocate
+		// immutable storage with a full mip chain on first use.
+		storage();
+		if (!data) {
+			return *this;
+		}
+		switch (m_type) {
+			case TextureType::Texture1D:
+				glTextureSubImage1D(m_id, 0, 0, m_width, m_format, dataType, data);
+				break;
+			case TextureType::Texture2D:
+				glTextureSubImage2D(m_id, 0, 0, 0, m_width, m_height, m_format, dataType, data);
+				break;
+			case TextureType::Texture3D:
+				glTextureSubImage3D(m_id, 0, 0, 0, 0, m_width, m_height, m_depth, m_format, dataType, data);
+				break;
+			default: return *this;
+		}
+		return *this;
+	}
+
 	GLenum ifmt = getInternalFormat(m_format, m_floatingPoint, m_depthSize);
 	switch (m_type) {
 		case TextureType::Texture1D:
@@ -92,17 +195,20 @@ Texture& Texture::update(const u8* data, DataType dataType) {
 }
 
 Texture& Texture::generateMipmaps() {
-	glGenerateMipmap(m_type);
+	if (Caps::directStateAccess()) {
+		glGenerateTextureMipmap(m_id);
+	} else {
+		glGenerateMipmap(m_type);
+	}
 	return *this;
 }
 
 Texture& Texture::bind(u32 slot) {
-	glActiveTexture(GL_TEXTURE0 + slot);
-	glBindTexture(m_type, m_id);
+	StateCache::get().bindTexture(slot, m_type, m_id);
 	return *this;
 }
 
-Texture& Texture::unbind() {
-	glBindTexture(m_type, 0);
+Texture& Texture::unbind(u32 slot) {
+	StateCache::get().bindTexture(slot, m_type, 0);
 	return *this;
 }
@@ -5,6 +5,7 @@
 #include "glad/glad.h"
 
 #include "buffer.h"
+#include "caps.h"
 
 #include <vector>
 
@@ -72,6 +73,9 @@ public:
 
 	Texture& array(u32 layerCount);
 
+	// Allocates immutable storage. Zero levels means a full mip chain.
+	Texture& storage(u32 levels = 0);
+
 	Texture& updateCube(const u8* data, CubeMapSide side, DataType dataType = DataType::TypeUByte);
 	Texture& updateArray(const u8* data, DataType dataType = DataType::TypeUByte);
 	Texture& update(const u8* data, DataType dataType);
@@ -79,7 +83,7 @@ public:
 	Texture& generateMipmaps();
 
 	Texture& bind(u32 slot = 0);
-	Texture& unbind();
+	Texture& unbind(u32 slot = 0);
 
 	GLuint id() const { return m_id; }
 
@@ -90,16 +94,20 @@ public:
 	TextureType type() const { return m_type; }
 	Format format() const { return m_format; }
 
+	Texture& markUsed(GpuTimeline& timeline) { m_lastUse = timeline.pending(); return *this; }
+	u64 lastUse() const { return m_lastUse; }
+
 private:
 	GLuint m_id{ 0 };
 	TextureType m_type;
 	Format m_format;
 
-	bool m_floatingPoint{ false };
+	bool m_floatingPoint{ false }, m_immutable{ false };
 	u32 m_depthSize{ 24 };
 	u32 m_layerCount{ 0 };
 
 	u32 m_width{ 0 }, m_height{ 0 }, m_depth{ 1 };
+	u64 m_lastUse{ 0 };
 };
 
 inline static GLenum getInternalFormat(Format format, bool floatingPoint = false, u32 depthSize = 24) {
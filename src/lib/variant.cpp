@@ -0,0 +1,132 @@
+#include "variant.h"
+#include "hash.h"
+
+#include <cctype>
+
+static bool isIdentifier(char c) {
+	return std::isalnum(u8(c)) || c == '_';
+}
+
+// Whole-word search, so FOO does not match FOO_BAR.
+static bool mentions(const std::string& source, const std::string& name) {
+	for (size_t at = source.find(name); at != std::string::npos; at = source.find(name, at + 1)) {
+		const size_t end = at + name.size();
+		if ((at == 0 || !isIdentifier(source[at - 1])) && (end == source.size() || !isIdentifier(source[end]))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+ShaderVariants& ShaderVariants::add(const std::string& source, Shader::ShaderType type) {
+	for (auto&& [t, src] : m_sources) {
+		if (t == type) return *this;
+	}
+	m_sources.emplace_back(type, source);
+	return *this;
+}
+
+ShaderVariants& ShaderVariants::async(bool enabled) {
+	m_async = enabled;
+	return *this;
+}
+
+ShaderVariants& ShaderVariants::fallback(const Shader& shader) {
+	m_fallback = &shader;
+	return *this;
+}
+
+void ShaderVariants::destroy() {
+	for (auto&& [key, program] : m_programs) {
+		program.destroy();
+	}
+	for (auto&& [key, stage] : m_stages) {
+		glDeleteShader(stage);
+	}
+	m_programs.clear();
+	m_stages.clear();
+	m_variants.clear();
+	m_stats = Stats{};
+}
+
+u64 ShaderVariants::variantId(const Shader::DefineMap& defines) {
+	// DefineMap is ordered, so equal sets hash equally.
+	u64 h = FnvOffset;
+	for (auto&& [name, value] : defines) {
+		h = hashString(name, h);
+		h = hashString("=", h);
+		h = hashString(value, h);
+		h = hashString(";", h);
+	}
+	return h;
+}
+
+Shader* ShaderVariants::find(u64 id) const {
+	auto pos = m_variants.find(id);
+	return pos == m_variants.end() ? nullptr : pos->second;
+}
+
+GLuint ShaderVariants::stage(const std::string& source, Shader::ShaderType type, u64 hash) {
+	m_stats.stageRequests++;
+
+	auto pos = m_stages.find(hash);
+	if (pos != m_stages.end()) {
+		return pos->second;
+	}
+
+	// Status is left to the program's link, like Shader::add.
+	GLuint s = glCreateShader(GLenum(type));
+	const char* src = source.c_str();
+	glShaderSource(s, 1, &src, nullptr);
+	glCompileShader(s);
+
+	m_stages[hash] = s;
+	m_stats.stages++;
+	return s;
+}
+
+Shader& ShaderVariants::get(const Shader::DefineMap& defines) {
+	const u64 id = variantId(defines);
+	if (Shader* shader = find(id)) {
+		return *shader;
+	}
+
+	std::vector<std::pair<Shader::ShaderType, GLuint>> stages;
+	u64 programKey = FnvOffset;
+	for (auto&& [type, source] : m_sources) {
+		Shader::DefineMap used;
+		for (auto&& [name, value] : defines) {
+			if (mentions(source, name)) used[name] = value;
+		}
+
+		const std::string text = Shader::injectDefines(source, used);
+		const u32 t = u32(type);
+		const u64 hash = hashString(text, hashBytes(&t, sizeof(t)));
+
+		stages.emplace_back(type, stage(text, type, hash));
+		programKey = hashBytes(&hash, sizeof(hash), programKey);
+	}
+
+	auto pos = m_programs.find(programKey);
+	if (pos == m_programs.end()) {
+		pos = m_programs.emplace(programKey, Shader{}).first;
+
+		Shader& program = pos->second;
+		program.create();
+		for (auto&& [type, s] : stages) {
+			program.attach(s, type);
+		}
+		if (m_fallback) {
+			program.fallback(*m_fallback);
+		}
+		program.link();
+		if (!m_async) {
+			program.wait();
+		}
+		m_stats.programs++;
+	}
+
+	m_variants[id] = &pos->second;
+	m_stats.variants++;
+	return pos->second;
+}
@@ -0,0 +1,61 @@
+#ifndef GFXE_VARIANT_H
+#define GFXE_VARIANT_H
+
+#include <vector>
+#include <unordered_map>
+
+#include "shader.h"
+
+// One set of stage sources compiled under many #define combinations.
+// Variants are built the first time they're requested. Each stage only
+// sees the defines its source mentions, so a toggle used by the fragment
+// stage alone does not produce new vertex shaders. Identical preprocessed
+// stages are compiled once and shared, and variants whose stages all match
+// share a single program.
+class ShaderVariants {
+public:
+	struct Stats {
+		u32 variants{ 0 };
+		u32 programs{ 0 };
+		u32 stages{ 0 };
+		u32 stageRequests{ 0 }; // stages the variants would compile on their own
+	};
+
+	ShaderVariants() = default;
+	~ShaderVariants() = default;
+
+	ShaderVariants& add(const std::string& source, Shader::ShaderType type);
+
+	// When async, get() returns without waiting for the link; pair it with
+	// a fallback so bind() has something to draw with meanwhile.
+	ShaderVariants& async(bool enabled);
+	ShaderVariants& fallback(const Shader& shader);
+
+	void destroy();
+
+	// Order-independent id of a define set.
+	static u64 variantId(const Shader::DefineMap& defines);
+
+	Shader& get(const Shader::DefineMap& defines);
+
+	// nullptr if the variant has not been requested yet.
+	Shader* find(u64 id) const;
+
+	const Stats& stats() const { return m_stats; }
+
+private:
+	std::vector<std::pair<Shader::ShaderType, std::string>> m_sources;
+
+	std::unordered_map<u64, Shader*> m_variants;
+	std::unordered_map<u64, Shader> m_programs; // by stage set
+	std::unordered_map<u64, GLuint> m_stages;   // by type and preprocessed source
+
+	const Shader* m_fallback{ nullptr };
+	bool m_async{ false };
+
+	Stats m_stats;
+
+	GLuint stage(const std::string& source, Shader::ShaderType type, u64 hash);
+};
+
+#endif // GFXE_VARIANT_H
@@ -3,11 +3,36 @@
 #include "window.h"
 #include "shader.h"
 #include "buffer.h"
+#include "layout.h"
 #include "texture.h"
 #include "framebuffer.h"
+#include "state.h"
+#include "log.h"
 
 #include "stb_image.h"
 
+// Unbinding a texture must not leave the cache believing it is still bound,
+// or the following bind is skipped and nothing ends up on the unit.
+static void checkTextureRebind() {
+	Texture probe;
+	probe.create(TextureType::Texture2D, Format::RGBA, 1, 1);
+
+	StateCache& cache = StateCache::get();
+	cache.resetCounters();
+	probe.bind(3).unbind(3).bind(3).bind(3);
+
+	const auto& c = cache.counters();
+	const u64 issued = c.issued[StateCache::CategoryTexture];
+	const u64 elided = c.elided[StateCache::CategoryTexture];
+	if (issued != 3 || elided != 1) {
+		LogError("Texture bind/unbind/bind: expected 3 issued and 1 elided, got ", issued, " and ", elided);
+	}
+
+	probe.unbind(3);
+	probe.destroy();
+	cache.resetCounters();
+}
+
 class Game : public GameAdapter {
 public:
 	void onSetup(Window* win) {
@@ -30,10 +55,12 @@ void main() {
 		shader.create()
 			.add(vs, Shader::VertexShader)
 			.add(fs, Shader::FragmentShader)
-			.link();
+			.link()
+			.wait();
 
-		VertexFormat<sizeof(float) * 3> fmt{};
-		fmt.add(3, DataType::TypeFloat);
+		texUniform = shader.findUniform("tex"_h);
+
+		using Layout = VertexLayout<Attr<3, DataType::TypeFloat>>;
 
 		f32 verts[] = {
 			-1.0f, -1.0f, 0.0f,
@@ -45,7 +72,7 @@ void main() {
 		buf.create(Buffer::ArrayBuffer)
 			.bind()
 			.update(std::vector<float>(verts, verts + 9));
-		fmt.enable();
+		Layout::enable();
 		arr.unbind();
 
 		i32 w, h, comp;
@@ -60,6 +87,8 @@ void main() {
 			stbi_image_free(data);
 		}
 
+		checkTextureRebind();
+
 		fbo.create(640, 480)
 			.color(TextureType::Texture2D, Format::RGB);
 	}
@@ -74,13 +103,16 @@ void main() {
 
 		arr.bind();
 		tex.bind();
-		shader.bind();
-		shader.get("tex").set(i32(0));
+		if (shader.generation() != texGeneration) {
+			texUniform = shader.findUniform("tex"_h);
+			texGeneration = shader.generation();
+		}
+		shader.set(texUniform, i32(0)).bind();
 
 		glDrawArrays(GL_TRIANGLES, 0, 3);
 
 		fbo.bind(FrameBufferTarget::ReadFrameBuffer, Attachment::ColorAttachment);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		StateCache::get().bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
 		fbo.blit(0, 0, 640, 480, 0, 0, 640, 480, ClearBufferMask::ColorBuffer, TextureFilter::Nearest);
 
@@ -90,6 +122,8 @@ void main() {
 	FrameBuffer fbo;
 	Texture tex;
 	Shader shader;
+	u32 texUniform{ Shader::InvalidIndex };
+	u32 texGeneration{ 0 };
 	Buffer buf;
 	VertexArray arr;
 };
@@ -4,6 +4,7 @@
 #include <algorithm>
 
 #include "glad/glad.h"
+#include "caps.h"
 #include "log.h"
 
 static void APIENTRY MessageCallback(
@@ -95,6 +96,8 @@ Window::Window(GameAdapter *adapter, u32 width, u32 height) {
 		return;
 	}
 
+	Caps::detect();
+
 	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 	glDebugMessageCallback(MessageCallback, 0);
 }